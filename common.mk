@@ -21,12 +21,30 @@ ifdef NID_DEBUG
 DEBUG := 1
 CFLAGS += -DNID_DEBUG
 endif
+ifdef IO_PROFILE
+DEBUG := 1
+CFLAGS += -DIO_PROFILE
+endif
+ifdef HOOK_PROFILE
+DEBUG := 1
+CFLAGS += -DHOOK_PROFILE
+endif
+ifdef DEBUG_SYNC
+DEBUG := 1
+CFLAGS += -DDEBUG_SYNC
+endif
+ifdef TRACE
+CFLAGS += -DTRACE
+endif
 ifdef DEBUG
 CFLAGS += -DDEBUG
 endif
 ifdef NO_SYSCALL_RESOLVER
 CFLAGS += -DNO_SYSCALL_RESOLVER
 endif
+ifdef SEMA_LOCKS
+CFLAGS += -DSEMA_LOCKS
+endif
 
 OBJ_DEBUG := common/debug.o
 OBJS_COMMON := common/utils/cache.o common/utils/fnt.o common/utils/scr.o	\
@@ -34,6 +52,9 @@ OBJS_COMMON := common/utils/cache.o common/utils/fnt.o common/utils/scr.o	\
 ifdef DEBUG
 OBJS_COMMON += $(OBJ_DEBUG)
 endif
+ifdef TRACE
+OBJS_COMMON += common/trace.o
+endif
 ifdef NO_SYSCALL_RESOLVER
 OBJS_COMMON += common/stubs/tables.o
 else
@@ -1,151 +1,180 @@
 #include <common/utils/string.h>
 #include <common/debug.h>
 #include <common/globals.h>
+#include <common/memory.h>
 #include <common/sdk.h>
 #include <common/utils.h>
 #include <config.h>
 
-static int hblPutc(char c, SceUID fd)
-{
-	return sceIoWrite(fd, &c, sizeof(c));
-}
-
-void dbg_puts(const char *s)
+#ifndef DEBUG_SYNC
+// Log ring buffer. head and tail count every byte ever appended and
+// flushed, so head - tail is what is pending and the offset in the ring
+// is the count modulo its size, which is a power of 2.
+static char *dbg_ring = NULL;
+static size_t dbg_ring_size = 0;
+static size_t dbg_head = 0;
+static size_t dbg_tail = 0;
+static size_t dbg_dropped = 0;
+static int dbg_flushing = 0;
+#endif
+
+// Writes straight to stdout and the log file
+static void dbg_write_sync(const char *s, size_t n)
 {
+	const char dbgOpenError[] = "dbg_write: " DBG_PATH "opening failed\n";
+	const char dbgCloseError[] = "dbg_write: " DBG_PATH "closing failed\n";
+	const char dbgWriteError[] = "\ndbg_write: " DBG_PATH "writing failed\n";
+	const char stdWriteError[] = "\ndbg_write: stdout writing failed\n";
 	SceUID fd;
-	size_t len;
 	int ret;
 
-	len = strlen(s);
-
-	ret = sceIoWrite(PSPLINK_OUT, s, len);
-	if (ret != len)
-		dbg_printf("%s: stdout writing failed 0x%08X\n",
-			__func__, ret);
-	ret = hblPutc('\n', PSPLINK_OUT);
-	if (ret < 0)
-		dbg_printf("%s: stdout writing failed 0x%08X\n",
-			__func__, ret);
-
 	fd = sceIoOpen(DBG_PATH, PSP_O_CREAT | PSP_O_WRONLY | PSP_O_APPEND, 0777);
 	if (fd < 0)
-		dbg_printf("%s: " DBG_PATH " opening failed 0x%08X\n",
-			__func__, fd);
-	else {
-		ret = sceIoWrite(fd, s, len);
-		if (ret != len)
-			dbg_printf("%s: " DBG_PATH " writing failed 0x%08X\n",
-				__func__, ret);
-		ret = hblPutc('\n', fd);
-		if (ret < 0)
-			dbg_printf("%s: " DBG_PATH " writing failed 0x%08X\n",
-				__func__, ret);
-		ret = sceIoClose(fd);
-		if (ret)
-			dbg_printf("%s: " DBG_PATH " closing failed 0x%08X\n",
-				__func__, ret);
-	}
+		sceIoWrite(PSPLINK_OUT, dbgOpenError, sizeof(dbgOpenError) - 1);
+
+	ret = sceIoWrite(PSPLINK_OUT, s, n);
+	if (ret != n)
+		sceIoWrite(fd, stdWriteError, sizeof(stdWriteError) - 1);
+	ret = sceIoWrite(fd, s, n);
+	if (ret != n)
+		sceIoWrite(PSPLINK_OUT, dbgWriteError, sizeof(dbgWriteError) - 1);
+
+	ret = sceIoClose(fd);
+	if (ret)
+		sceIoWrite(PSPLINK_OUT, dbgCloseError, sizeof(dbgCloseError) - 1);
 }
 
-// DBG_PRINTF implementation
+#ifndef DEBUG_SYNC
+void dbg_log_init(char *buf, size_t size)
+{
+	dbg_ring = buf;
+	dbg_ring_size = size;
+	dbg_head = 0;
+	dbg_tail = 0;
+	dbg_dropped = 0;
+	dbg_flushing = 0;
+}
 
-static int dbg_itoa(unsigned val, char *buf, int base, int w)
+void dbg_flush()
 {
-	char *p1, *p2;
-	char c;
-	int i = 0;
-	int rem;
-
-	do {
-		rem = val % base;
-		buf[i++] = (rem < 10 ? 0x30 : 0x37) + rem;
-		val /= base;
-		w--;
-	} while (val || w > 0);
-
-	p1 = buf;
-	p2 = buf + i - 1;
-	while (p1 < p2) {
-		c = *p2;
-		*p2-- = *p1;
-		*p1++ = c;
+	const char dropped[] = "\n[log buffer overflowed, lines dropped]\n";
+	size_t head, tail, off, n;
+	int state, lost;
+
+	if (dbg_ring == NULL)
+		return;
+
+	// The pending bytes are not touched by writers until dbg_tail moves,
+	// so they can be written out of the critical section
+	state = hblLock(globals->memSema);
+	if (dbg_flushing) {
+		hblUnlock(globals->memSema, state);
+		return;
 	}
+	dbg_flushing = 1;
+	head = dbg_head;
+	tail = dbg_tail;
+	lost = dbg_dropped > 0;
+	dbg_dropped = 0;
+	hblUnlock(globals->memSema, state);
+
+	if (head != tail) {
+		off = tail & (dbg_ring_size - 1);
+		n = head - tail;
+		if (n > dbg_ring_size - off) {
+			dbg_write_sync(dbg_ring + off, dbg_ring_size - off);
+			n -= dbg_ring_size - off;
+			off = 0;
+		}
+		dbg_write_sync(dbg_ring + off, n);
+	}
+
+	if (lost)
+		dbg_write_sync(dropped, sizeof(dropped) - 1);
 
-	return i;
+	state = hblLock(globals->memSema);
+	dbg_tail = head;
+	dbg_flushing = 0;
+	hblUnlock(globals->memSema, state);
 }
 
-void dbg_vprintf(const char *fmt, va_list va)
+// Copies into the ring if it has room. Returns the bytes now pending,
+// or 0 if it is full.
+static size_t dbg_append(const char *s, size_t n)
 {
-	SceUID fd;
-	const char dbgOpenError[] = "dbg_vprintf: " DBG_PATH "opening failed\n";
-	const char dbgCloseError[] = "dbg_vprintf: " DBG_PATH "closing failed\n";
-	const char dbgWriteError[] = "\ndbg_vprintf: " DBG_PATH "writing failed\n";
-	const char stdWriteError[] = "\ndbg_vprintf: stdout writing failed\n";
-	const char *p;
-	char buf[11];
-	char c, w;
-	int i, ret, val;
+	size_t off, first, pending;
+	int state;
 
-	fd = sceIoOpen(DBG_PATH, PSP_O_CREAT | PSP_O_WRONLY | PSP_O_APPEND, 0777);
-	if (fd < 0)
-		sceIoWrite(PSPLINK_OUT, dbgOpenError, sizeof(dbgOpenError) - 1);
+	state = hblLock(globals->memSema);
 
-	while ((c = *fmt) != '\0') {
-		if (c != '%') {
-			p = fmt;
-
-			for (i = 1; fmt[i] != '%' && fmt[i]; i++);
-			fmt += i;
-		} else {
-			fmt++;
-			c = *fmt++;
-
-			w = 0;
-			if (c == '0') {
-				c = *fmt++;
-				if (c >= '0' && c <= '8') {
-					w = c - '0';
-					c = *fmt++;
-				}
-			}
+	pending = dbg_head - dbg_tail;
+	if (n > dbg_ring_size - pending) {
+		hblUnlock(globals->memSema, state);
+		return 0;
+	}
+
+	off = dbg_head & (dbg_ring_size - 1);
+	first = dbg_ring_size - off;
+	if (first > n)
+		first = n;
+	memcpy(dbg_ring + off, s, first);
+	memcpy(dbg_ring, s + first, n - first);
+
+	dbg_head += n;
+	pending += n;
+
+	hblUnlock(globals->memSema, state);
+
+	return pending;
+}
+#endif
 
-			switch (c) {
-				case 'd':
-					p = buf;
-
-					val = va_arg(va, int);
-					if (val < 0) {
-						buf[0] = '-';
-						val= -val;
-						i = dbg_itoa((unsigned)val, buf + 1, 10, w);
-					} else
-						i = dbg_itoa((unsigned)val, buf, 10, w);
-					break;
-				case 'X' : 
-					p = buf;
-					i = dbg_itoa((unsigned)va_arg(va, int), buf, 16, w);
-					break;
-				case 's' :
-					p = va_arg(va, const char *);
-					i = strlen(p);
-					break;
-				default:
-					p = NULL;
-					i = 0;
+void dbg_write(const char *s, size_t n)
+{
+#ifndef DEBUG_SYNC
+	size_t pending;
+	int state;
+
+	if (dbg_ring != NULL && n <= dbg_ring_size) {
+		pending = dbg_append(s, n);
+		if (pending == 0) {
+			// Full: make room and try once more, then give up
+			dbg_flush();
+			pending = dbg_append(s, n);
+			if (pending == 0) {
+				state = hblLock(globals->memSema);
+				dbg_dropped += n;
+				hblUnlock(globals->memSema, state);
+				return;
 			}
 		}
 
-		ret = sceIoWrite(PSPLINK_OUT, p, i);
-		if (ret != i)
-			sceIoWrite(fd, stdWriteError, sizeof(stdWriteError) - 1);
-		ret = sceIoWrite(fd, p, i);
-		if (ret != i)
-			sceIoWrite(PSPLINK_OUT, dbgWriteError, sizeof(dbgWriteError) - 1);
+		if (pending >= DBG_LOG_FLUSH)
+			dbg_flush();
+
+		return;
 	}
+#endif
 
-	ret = sceIoClose(fd);
-	if (ret)
-		sceIoWrite(PSPLINK_OUT, dbgCloseError, sizeof(dbgCloseError) - 1);
+	dbg_write_sync(s, n);
+}
+
+void dbg_puts(const char *s)
+{
+	dbg_write(s, strlen(s));
+	dbg_write("\n", 1);
+}
+
+static void dbg_sink(const char *s, size_t n, void *arg)
+{
+	dbg_write(s, n);
+}
+
+void dbg_vprintf(const char *fmt, va_list va)
+{
+	char buf[FORMAT_BUF_SIZE];
+
+	_vformat(buf, sizeof(buf), dbg_sink, NULL, fmt, va);
 }
 
 void dbg_printf(const char *fmt, ...)
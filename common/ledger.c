@@ -0,0 +1,153 @@
+#include <common/utils/scr.h>
+#include <common/debug.h>
+#include <common/globals.h>
+#include <common/ledger.h>
+#include <common/memory.h>
+#include <common/sdk.h>
+#include <common/trace.h>
+
+static LedgerEntry *ledger = NULL;
+static unsigned ledger_max = 0;
+static unsigned ledger_num = 0;
+
+#ifdef DEBUG
+static const char * const owner_names[] = { "HBL", "loader", "homebrew" };
+#endif
+
+void ledger_init(LedgerEntry *table, unsigned max)
+{
+	ledger = table;
+	ledger_max = max;
+	ledger_num = 0;
+}
+
+int ledger_add(SceUID uid, const char *name, SceSize size, LedgerOwner owner)
+{
+	LedgerEntry *entry;
+	int i, state;
+
+	if (ledger == NULL)
+		return 0;
+
+	state = hblLock(globals->memSema);
+
+	if (ledger_num >= ledger_max) {
+		hblUnlock(globals->memSema, state);
+		dbg_printf("!!! EXCEEDED ALLOCATION LEDGER, 0x%08X not tracked\n", uid);
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+	}
+
+	entry = ledger + ledger_num;
+	entry->uid = uid;
+	entry->size = size;
+	entry->owner = owner;
+
+	i = 0;
+	if (name != NULL)
+		for (; i < LEDGER_NAME_LEN - 1 && name[i]; i++)
+			entry->name[i] = name[i];
+	entry->name[i] = '\0';
+
+	ledger_num++;
+
+	hblUnlock(globals->memSema, state);
+
+	trace_event(TRACE_ALLOC, uid, size, owner);
+
+	return 0;
+}
+
+int ledger_remove(SceUID uid)
+{
+	unsigned i;
+	int state;
+
+	if (ledger == NULL)
+		return 0;
+
+	state = hblLock(globals->memSema);
+
+	// The order does not matter, so fill the hole with the last entry
+	for (i = 0; i < ledger_num; i++)
+		if (ledger[i].uid == uid) {
+			ledger_num--;
+			ledger[i] = ledger[ledger_num];
+
+			hblUnlock(globals->memSema, state);
+			trace_event(TRACE_FREE, uid, 0, 0);
+			return 0;
+		}
+
+	hblUnlock(globals->memSema, state);
+
+	return SCE_KERNEL_ERROR_ERROR;
+}
+
+SceUID ledger_alloc(LedgerOwner owner, const char *name, int type, SceSize size, void *addr)
+{
+	SceUID uid;
+
+	uid = sceKernelAllocPartitionMemory(2, name, type, size, addr);
+	if (uid >= 0)
+		ledger_add(uid, name, size, owner);
+
+	return uid;
+}
+
+int ledger_free(SceUID uid)
+{
+	int ret;
+
+	ret = sceKernelFreePartitionMemory(uid);
+	if (ret >= 0)
+		ledger_remove(uid);
+
+	return ret;
+}
+
+int ledger_cleanup()
+{
+	LedgerEntry entry;
+	unsigned i;
+	int leaks = 0;
+	int state;
+
+	if (ledger == NULL)
+		return 0;
+
+	// Take the blocks out one at a time, so that nothing is printed
+	// or freed inside the critical section
+	i = 0;
+	for (;;) {
+		state = hblLock(globals->memSema);
+
+		while (i < ledger_num && ledger[i].owner == LEDGER_HBL)
+			i++;
+
+		if (i >= ledger_num) {
+			hblUnlock(globals->memSema, state);
+			break;
+		}
+
+		entry = ledger[i];
+		ledger_num--;
+		ledger[i] = ledger[ledger_num];
+
+		hblUnlock(globals->memSema, state);
+
+		trace_event(TRACE_FREE, entry.uid, 0, 0);
+
+		if (entry.owner == LEDGER_LOADER) {
+			scr_printf("WARNING! Memory leak: %s (0x%08X, %d bytes)\n",
+				entry.name, entry.uid, entry.size);
+			leaks++;
+		} else
+			dbg_printf("Freeing %s block %s (0x%08X, %d bytes)\n",
+				owner_names[entry.owner], entry.name,
+				entry.uid, entry.size);
+
+		sceKernelFreePartitionMemory(entry.uid);
+	}
+
+	return leaks;
+}
@@ -1,10 +1,51 @@
 #include <common/debug.h>
+#include <common/memory.h>
 #include <common/sdk.h>
 #include <config.h>
 
 #define MODULES_START_ADDRESS 0x08804000
 #define MAX_MODULES_TO_FREE 0x20
 
+int hblWaitSema(SceUID semaid, int signal, SceUInt *timeout)
+{
+	if (isImported(sceKernelWaitSema))
+		return sceKernelWaitSema(semaid, signal, timeout);
+	else if (isImported(sceKernelWaitSemaCB))
+		return sceKernelWaitSemaCB(semaid, signal, timeout);
+	else
+		return SCE_KERNEL_ERROR_ERROR;
+}
+
+#ifndef SEMA_LOCKS
+// Kernel_Library is a user library, so its stubs are resolved to jumps
+// instead of syscalls and isImported() does not recognize them
+#define isJumpResolved(f) ((((u32 *)(f))[0] & 0xFC000000) == J_OPCODE)
+#endif
+
+int hblLock(SceUID semaid)
+{
+#ifndef SEMA_LOCKS
+	if (isJumpResolved(sceKernelCpuSuspendIntr)
+		&& isJumpResolved(sceKernelCpuResumeIntr))
+		return sceKernelCpuSuspendIntr();
+#endif
+
+	hblWaitSema(semaid, 1, 0);
+	return HBL_LOCK_SEMA;
+}
+
+void hblUnlock(SceUID semaid, int state)
+{
+#ifndef SEMA_LOCKS
+	if (state != HBL_LOCK_SEMA) {
+		sceKernelCpuResumeIntr(state);
+		return;
+	}
+#endif
+
+	sceKernelSignalSema(semaid, 1);
+}
+
 int kill_thread(SceUID thid)
 {
 	int ret;
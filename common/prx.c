@@ -1,6 +1,7 @@
 #include <common/utils/string.h>
 #include <common/debug.h>
 #include <common/prx.h>
+#include <common/scratch.h>
 #include <common/sdk.h>
 #include <hbl/modmgr/elf.h>
 
@@ -63,7 +64,6 @@ static void unalignSh(void *p, uint16_t h)
 
 static int relocSec(SceUID fd, SceOff off, const Elf32_Shdr *shdr, void *base)
 {
-	SceUID block;
 	tRelEntry *top, *entry;
 	void *dst;
 	Elf32_Word hiAdd, w;
@@ -76,18 +76,15 @@ static int relocSec(SceUID fd, SceOff off, const Elf32_Shdr *shdr, void *base)
 	if (r < 0)
 		return r;
 
-	block = sceKernelAllocPartitionMemory(2, "HBL Relocation Section",
-		PSP_SMEM_Low, shdr->sh_size, NULL);
-	if (block < 0)
-		return block;
-
-	top = sceKernelGetBlockHeadAddr(block);
+	top = scratch_alloc(shdr->sh_size);
 	if (top == NULL)
-		return SCE_KERNEL_ERROR_ERROR;
+		return SCE_KERNEL_ERROR_NO_MEMORY;
 
 	r = sceIoRead(fd, top, shdr->sh_size);
-	if (r < 0)
+	if (r < 0) {
+		scratch_pop(top);
 		return r;
+	}
 
 	hiAdd = 0;
 	entry = (void *)((uintptr_t)top + shdr->sh_size);
@@ -134,15 +131,15 @@ static int relocSec(SceUID fd, SceOff off, const Elf32_Shdr *shdr, void *base)
 		}
 	}
 
-	return sceKernelFreePartitionMemory(block);
+	scratch_pop(top);
+	return 0;
 }
 
 // Relocates all sections that need to
 static int relocAll(SceUID fd, SceOff off, const Elf32_Ehdr *hdr, void *base)
 {
 	SceSize size;
-	SceUID block;
-	Elf32_Shdr *p, *btm;
+	Elf32_Shdr *top, *p, *btm;
 	int r;
 
 	if (hdr == NULL || base == NULL)
@@ -154,24 +151,18 @@ static int relocAll(SceUID fd, SceOff off, const Elf32_Ehdr *hdr, void *base)
 	if (r < 0)
 		return r;
 
-	block = sceKernelAllocPartitionMemory(2, "HBL Module Section Headers",
-		PSP_SMEM_Low, size, NULL);
-	if (block < 0)
-		return block;
-
-	p = sceKernelGetBlockHeadAddr(block);
-	if (p == NULL) {
-		sceKernelFreePartitionMemory(block);
-		return SCE_KERNEL_ERROR_ERROR;
-	}
+	top = scratch_alloc(size);
+	if (top == NULL)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
 
-	r = sceIoRead(fd, p, size);
+	r = sceIoRead(fd, top, size);
 	if (r < 0) {
-		sceKernelFreePartitionMemory(block);
+		scratch_pop(top);
 		return r;
 	}
 
-	for (btm = p + hdr->e_shnum; p != btm; p++) {
+	btm = top + hdr->e_shnum;
+	for (p = top; p != btm; p++) {
 		if (p->sh_type != LOPROC)
 			continue;
 
@@ -180,7 +171,8 @@ static int relocAll(SceUID fd, SceOff off, const Elf32_Ehdr *hdr, void *base)
 			dbg_printf("warning: relocating failed 0x%08X\n", r);
 	}
 
-	return sceKernelFreePartitionMemory(block);
+	scratch_pop(top);
+	return 0;
 }
 
 // Loads relocatable executable in memory using fixed address
@@ -0,0 +1,139 @@
+#include <common/debug.h>
+#include <common/ledger.h>
+#include <common/scratch.h>
+#include <common/sdk.h>
+
+// Buffers are aligned on this so that ELF structures can be read in place
+#define SCRATCH_ALIGN 16
+
+static SceUID arena_block = -1;
+static char *arena = NULL;
+static SceSize arena_size = 0;
+static SceSize arena_top = 0;
+
+static struct {
+	SceUID uid;
+	void *p;
+	SceSize size;
+} overflow[SCRATCH_OVERFLOW_MAX];
+static unsigned overflow_num = 0;
+
+// Bytes requested since the last reset, including overflow blocks
+static SceSize used = 0;
+static SceSize peak = 0;
+
+int scratch_init(SceSize size)
+{
+	SceUID block;
+
+	block = ledger_alloc(LEDGER_HBL, "HBL Scratch", PSP_SMEM_High, size, NULL);
+	if (block < 0)
+		return block;
+
+	arena = sceKernelGetBlockHeadAddr(block);
+	if (arena == NULL) {
+		ledger_free(block);
+		return SCE_KERNEL_ERROR_ERROR;
+	}
+
+	arena_block = block;
+	arena_size = size;
+	arena_top = 0;
+
+	return 0;
+}
+
+void *scratch_alloc(SceSize size)
+{
+	SceUID block;
+	void *p;
+
+	size = (size + SCRATCH_ALIGN - 1) & ~(SCRATCH_ALIGN - 1);
+
+	used += size;
+	if (used > peak)
+		peak = used;
+
+	// Nothing may be bump-allocated over a live overflow block,
+	// or popping would release them out of order
+	if (overflow_num == 0 && arena_top + size <= arena_size) {
+		p = arena + arena_top;
+		arena_top += size;
+		return p;
+	}
+
+	if (overflow_num >= SCRATCH_OVERFLOW_MAX) {
+		dbg_printf("%s: too many overflow blocks\n", __func__);
+		used -= size;
+		return NULL;
+	}
+
+	block = ledger_alloc(LEDGER_LOADER, "HBL Scratch Overflow",
+		PSP_SMEM_High, size, NULL);
+	if (block < 0) {
+		used -= size;
+		return NULL;
+	}
+
+	p = sceKernelGetBlockHeadAddr(block);
+	if (p == NULL) {
+		ledger_free(block);
+		used -= size;
+		return NULL;
+	}
+
+	overflow[overflow_num].uid = block;
+	overflow[overflow_num].p = p;
+	overflow[overflow_num].size = size;
+	overflow_num++;
+
+	return p;
+}
+
+void scratch_pop(void *p)
+{
+	while (overflow_num > 0) {
+		overflow_num--;
+		ledger_free(overflow[overflow_num].uid);
+		used -= overflow[overflow_num].size;
+		if (overflow[overflow_num].p == p)
+			return;
+	}
+
+	if ((char *)p >= arena && (char *)p < arena + arena_top) {
+		used -= arena + arena_top - (char *)p;
+		arena_top = (char *)p - arena;
+	}
+}
+
+void scratch_reset()
+{
+	SceSize size;
+
+	while (overflow_num > 0) {
+		overflow_num--;
+		ledger_free(overflow[overflow_num].uid);
+	}
+
+	arena_top = 0;
+	used = 0;
+
+	if (arena_block < 0 || peak <= arena_size || arena_size >= SCRATCH_MAX_SIZE) {
+		peak = 0;
+		return;
+	}
+
+	size = (peak + 4095) & ~4095;
+	if (size > SCRATCH_MAX_SIZE)
+		size = SCRATCH_MAX_SIZE;
+	peak = 0;
+
+	dbg_printf("Growing scratch arena from %d to %d bytes\n", arena_size, size);
+
+	ledger_free(arena_block);
+	if (scratch_init(size) < 0 && scratch_init(arena_size) < 0) {
+		arena_block = -1;
+		arena = NULL;
+		arena_size = 0;
+	}
+}
@@ -0,0 +1,136 @@
+#include <common/globals.h>
+#include <common/memory.h>
+#include <common/sdk.h>
+#include <common/trace.h>
+
+// head and tail count every record ever added and written out, so the
+// slot of a record is its count modulo the buffer size
+static TraceRecord *trace_buf = NULL;
+static unsigned trace_num = 0;
+static unsigned trace_head = 0;
+static unsigned trace_tail = 0;
+static unsigned trace_lost = 0;
+static int trace_flushing = 0;
+
+static u32 trace_clock()
+{
+	return isImported(sceKernelGetSystemTimeLow) ? sceKernelGetSystemTimeLow() : 0;
+}
+
+static void trace_write(SceUID fd, const void *p, unsigned num)
+{
+	if (num > 0)
+		sceIoWrite(fd, p, num * sizeof(TraceRecord));
+}
+
+void trace_init(TraceRecord *buf, unsigned num)
+{
+	TraceHeader header;
+	SceUID fd;
+
+	trace_buf = buf;
+	trace_num = num;
+	trace_head = 0;
+	trace_tail = 0;
+	trace_lost = 0;
+	trace_flushing = 0;
+
+	header.magic = TRACE_MAGIC;
+	header.version = TRACE_VERSION;
+	header.record_size = sizeof(TraceRecord);
+	header.tick_rate = 1000000;
+
+	fd = sceIoOpen(TRACE_PATH, PSP_O_CREAT | PSP_O_WRONLY | PSP_O_TRUNC, 0777);
+	if (fd >= 0) {
+		sceIoWrite(fd, &header, sizeof(header));
+		sceIoClose(fd);
+	}
+}
+
+void trace_flush()
+{
+	TraceRecord lost;
+	unsigned head, tail, off, n;
+	SceUID fd;
+	int state;
+
+	if (trace_buf == NULL)
+		return;
+
+	// The pending records are not touched by writers until trace_tail
+	// moves, so they can be written out of the critical section
+	state = hblLock(globals->memSema);
+	if (trace_flushing) {
+		hblUnlock(globals->memSema, state);
+		return;
+	}
+	trace_flushing = 1;
+	head = trace_head;
+	tail = trace_tail;
+	lost.args[0] = trace_lost;
+	trace_lost = 0;
+	hblUnlock(globals->memSema, state);
+
+	fd = sceIoOpen(TRACE_PATH, PSP_O_CREAT | PSP_O_WRONLY | PSP_O_APPEND, 0777);
+	if (fd >= 0) {
+		off = tail & (trace_num - 1);
+		n = head - tail;
+		if (n > trace_num - off) {
+			trace_write(fd, trace_buf + off, trace_num - off);
+			n -= trace_num - off;
+			off = 0;
+		}
+		trace_write(fd, trace_buf + off, n);
+
+		if (lost.args[0]) {
+			lost.event = TRACE_LOST;
+			lost.reserved = 0;
+			lost.tick = trace_clock();
+			lost.args[1] = 0;
+			lost.args[2] = 0;
+			trace_write(fd, &lost, 1);
+		}
+
+		sceIoClose(fd);
+	}
+
+	state = hblLock(globals->memSema);
+	trace_tail = head;
+	trace_flushing = 0;
+	hblUnlock(globals->memSema, state);
+}
+
+void trace_event(TraceEvent event, u32 a, u32 b, u32 c)
+{
+	TraceRecord *record;
+	unsigned pending;
+	int state;
+
+	if (trace_buf == NULL)
+		return;
+
+	state = hblLock(globals->memSema);
+
+	pending = trace_head - trace_tail;
+	if (pending >= trace_num) {
+		trace_lost++;
+		hblUnlock(globals->memSema, state);
+		return;
+	}
+
+	record = trace_buf + (trace_head & (trace_num - 1));
+	record->event = event;
+	record->reserved = 0;
+	record->tick = trace_clock();
+	record->args[0] = a;
+	record->args[1] = b;
+	record->args[2] = c;
+
+	trace_head++;
+	pending++;
+
+	hblUnlock(globals->memSema, state);
+
+	if (pending >= trace_num / 2)
+		trace_flush();
+}
@@ -0,0 +1,92 @@
+#include <common/utils/string.h>
+#include <common/sdk.h>
+#include <common/uidtable.h>
+
+#define ENTRY(t, i) ((SceUID *)((char *)(t)->entries + (i) * (t)->size))
+
+static unsigned uidtable_hash(const UidTable *t, SceUID uid)
+{
+	return ((u32)uid * 0x9E3779B1) >> (32 - t->bits);
+}
+
+// Returns the slot of uid, or the empty slot where it would go
+static unsigned uidtable_slot(const UidTable *t, SceUID uid)
+{
+	const unsigned mask = UIDTABLE_SLOTS(t) - 1;
+	unsigned i;
+
+	for (i = uidtable_hash(t, uid);
+		*ENTRY(t, i) && *ENTRY(t, i) != uid;
+		i = (i + 1) & mask);
+
+	return i;
+}
+
+void *uidtable_find(const UidTable *t, SceUID uid)
+{
+	SceUID *entry;
+
+	if (!uid)
+		return NULL;
+
+	entry = ENTRY(t, uidtable_slot(t, uid));
+
+	return *entry ? entry : NULL;
+}
+
+void *uidtable_add(UidTable *t, SceUID uid)
+{
+	SceUID *entry;
+
+	if (!uid)
+		return NULL;
+
+	entry = ENTRY(t, uidtable_slot(t, uid));
+	if (!*entry) {
+		if (t->num >= UIDTABLE_SLOTS(t) / 4 * 3)
+			return NULL;
+
+		memset(entry, 0, t->size);
+		*entry = uid;
+		t->num++;
+	}
+
+	return entry;
+}
+
+void uidtable_remove(UidTable *t, SceUID uid)
+{
+	const unsigned mask = UIDTABLE_SLOTS(t) - 1;
+	unsigned i, j, k;
+
+	if (!uid)
+		return;
+
+	i = uidtable_slot(t, uid);
+	if (!*ENTRY(t, i))
+		return;
+
+	t->num--;
+
+	// Pull back the entries that probed past the freed slot
+	j = i;
+	for (;;) {
+		j = (j + 1) & mask;
+		if (!*ENTRY(t, j))
+			break;
+
+		k = uidtable_hash(t, *ENTRY(t, j));
+		if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+			memcpy(ENTRY(t, i), ENTRY(t, j), t->size);
+			i = j;
+		}
+	}
+
+	memset(ENTRY(t, i), 0, t->size);
+}
+
+void uidtable_clear(UidTable *t)
+{
+	memset(t->entries, 0, t->size << t->bits);
+	t->num = 0;
+}
@@ -1,36 +1,80 @@
 #include <common/utils/string.h>
+#include <common/debug.h>
+#include <common/trace.h>
 #include <common/utils.h>
 
 // Searches for s string in memory
 // Returns pointer to string
 void *findstr(const char *s, const void *p, size_t size)
 {
-	while (size) {
-                if (!strcmp((const char *)p, s))
-                        return (void *)p;
-		size--;
-		p++;
+	unsigned char skip[256];
+	const unsigned char *c = p;
+	size_t i, m;
+
+	// The terminator is part of the match
+	m = strlen(s) + 1;
+
+	/*
+	 * Horspool: when the window doesn't match, slide it so that its last
+	 * byte lines up with the last occurrence of that byte in s. Windows
+	 * running past the end are left to strcmp, which stops at the first
+	 * mismatch instead of reading m bytes past the area.
+	 */
+	if (m < sizeof(skip) && m <= size) {
+		for (i = 0; i < sizeof(skip); i++)
+			skip[i] = m;
+		for (i = 0; i < m - 1; i++)
+			skip[(unsigned char)s[i]] = m - 1 - i;
+
+		while (size >= m) {
+			if (!c[m - 1] && c[0] == (unsigned char)s[0]
+				&& !memcmp(c, s, m - 1))
+			{
+				return (void *)c;
+			}
+
+			i = skip[c[m - 1]];
+			c += i;
+			size -= i;
+		}
 	}
 
-        return NULL;
+	for (; size; size--, c++)
+		if (!strcmp((const char *)c, s))
+			return (void *)c;
+
+	return NULL;
 }
 
 // Searches for word value on memory
 // Returns pointer to value
 void *findw(int val, const void *p, size_t size)
 {
-	while (size) {
-                if (*(int *)p == val)
-                        return (void *)p;
-		size -= sizeof(int);
-		p += sizeof(int);
+	const int *w = p;
+
+	for (; size >= 4 * sizeof(int); size -= 4 * sizeof(int), w += 4) {
+		if (w[0] == val)
+			return (void *)w;
+		if (w[1] == val)
+			return (void *)(w + 1);
+		if (w[2] == val)
+			return (void *)(w + 2);
+		if (w[3] == val)
+			return (void *)(w + 3);
 	}
 
-        return NULL;
+	for (; size >= sizeof(int); size -= sizeof(int), w++)
+		if (*w == val)
+			return (void *)w;
+
+	return NULL;
 }
 
 void hblExitGameWithStatus(int status)
 {
+	dbg_flush();
+	trace_flush();
+
 	if (isImported(sceKernelExitGameWithStatus))
 		sceKernelExitGameWithStatus(status);
 	else if (isImported(sceKernelExitGame))
@@ -22,3 +22,67 @@ loop:
 
 	.end	synci
 	.size	synci, .-synci
+
+# Writes back and invalidates the whole 16kB data cache with index
+# operations. Each index is hit twice, once for each way.
+	.globl	dcache_wbinv_all
+	.ent	dcache_wbinv_all
+	.type	dcache_wbinv_all, @function
+dcache_wbinv_all:
+	lui	$a0, 0x0880
+	addiu	$a1, $a0, 0x4000
+all_loop:
+	addiu	$a0, $a0, 64
+	cache	0x14, -64($a0)
+	sltu	$at, $a0, $a1
+	bnez	$at, all_loop
+	cache	0x14, -64($a0)
+
+	jr	$ra
+	nop
+
+	.end	dcache_wbinv_all
+	.size	dcache_wbinv_all, .-dcache_wbinv_all
+
+# Ranges bigger than the data cache are cheaper to flush as a whole
+	.globl	dcache_wb_range
+	.ent	dcache_wb_range
+	.type	dcache_wb_range, @function
+dcache_wb_range:
+	subu	$at, $a1, $a0
+	sltiu	$at, $at, 0x4001
+	beqz	$at, dcache_wbinv_all
+	li	$at, 0xFFFFFFC0
+	and	$a0, $a0, $at
+wb_loop:
+	addiu	$a0, $a0, 64
+	sltu	$at, $a0, $a1
+	bnez	$at, wb_loop
+	cache	0x1A, -64($a0)
+
+	jr	$ra
+	nop
+
+	.end	dcache_wb_range
+	.size	dcache_wb_range, .-dcache_wb_range
+
+	.globl	dcache_wbinv_range
+	.ent	dcache_wbinv_range
+	.type	dcache_wbinv_range, @function
+dcache_wbinv_range:
+	subu	$at, $a1, $a0
+	sltiu	$at, $at, 0x4001
+	beqz	$at, dcache_wbinv_all
+	li	$at, 0xFFFFFFC0
+	and	$a0, $a0, $at
+wbinv_loop:
+	addiu	$a0, $a0, 64
+	sltu	$at, $a0, $a1
+	bnez	$at, wbinv_loop
+	cache	0x1B, -64($a0)
+
+	jr	$ra
+	nop
+
+	.end	dcache_wbinv_range
+	.size	dcache_wbinv_range, .-dcache_wbinv_range
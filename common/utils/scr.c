@@ -7,34 +7,99 @@
 #define	LINE_SIZE 512
 #define SCR_WIDTH 480
 #define SCR_HEIGHT 272
+#define SCR_ROWS (SCR_HEIGHT / FNT_HEIGHT)
 
 static int (* vram)[LINE_SIZE] = (void *)0x04000000;
 
+// Bit n is set once text row n has been drawn on, so that scr_init only
+// clears those. Whatever was on the screen before the first call is
+// unknown, so every row starts dirty.
+static unsigned int scr_dirty = (1 << SCR_ROWS) - 1;
+
+// Pixel masks of each 4-pixel half of a glyph row, leftmost pixel first
+#define NIBBLE_MASK(n) {			\
+	(n) & 8 ? -1 : 0, (n) & 4 ? -1 : 0,	\
+	(n) & 2 ? -1 : 0, (n) & 1 ? -1 : 0	\
+}
+
+static const int nibble_mask[16][4] = {
+	NIBBLE_MASK(0), NIBBLE_MASK(1), NIBBLE_MASK(2), NIBBLE_MASK(3),
+	NIBBLE_MASK(4), NIBBLE_MASK(5), NIBBLE_MASK(6), NIBBLE_MASK(7),
+	NIBBLE_MASK(8), NIBBLE_MASK(9), NIBBLE_MASK(10), NIBBLE_MASK(11),
+	NIBBLE_MASK(12), NIBBLE_MASK(13), NIBBLE_MASK(14), NIBBLE_MASK(15)
+};
+
 int cur_x = 0;
 int cur_y = 0;
 
 void scr_init()
 {
+	int row;
+
 	sceDisplaySetFrameBuf(
 		(void *)vram,
 		LINE_SIZE,
 		PSP_DISPLAY_PIXEL_FORMAT_8888,
 		PSP_DISPLAY_SETBUF_NEXTFRAME);
-	memset((void *)vram, 0, SCR_HEIGHT * LINE_SIZE * 4);
+
+	for (row = 0; scr_dirty; row++, scr_dirty >>= 1)
+		if (scr_dirty & 1)
+			memset(vram[row * FNT_HEIGHT], 0,
+				FNT_HEIGHT * sizeof(vram[0]));
+
 	cur_x = cur_y = 0;
 }
 
+// Moves the text up by one row and blanks the bottom one
+static void scr_scroll()
+{
+	int y;
+
+	for (y = 0; y < SCR_HEIGHT - FNT_HEIGHT; y++)
+		memcpy(vram[y], vram[y + FNT_HEIGHT], SCR_WIDTH * sizeof(vram[0][0]));
+
+	memset(vram[SCR_HEIGHT - FNT_HEIGHT], 0, FNT_HEIGHT * sizeof(vram[0]));
+
+	// Each row now shows what the one below it held
+	scr_dirty |= scr_dirty >> 1;
+	cur_y -= FNT_HEIGHT;
+}
+
+// Draws a glyph at the cursor a row at a time, so that VRAM is written
+// sequentially instead of with a whole line of stride per pixel
+static void scr_draw_glyph(int c, int col)
+{
+	const int *hi, *lo;
+	int *row;
+	int fnt_y, bits;
+
+	row = vram[cur_y] + cur_x;
+	for (fnt_y = 0; fnt_y < FNT_HEIGHT; fnt_y++) {
+		bits = (unsigned char)fnt[c][fnt_y];
+		hi = nibble_mask[bits >> 4];
+		lo = nibble_mask[bits & 15];
+
+		row[0] = hi[0] & col;
+		row[1] = hi[1] & col;
+		row[2] = hi[2] & col;
+		row[3] = hi[3] & col;
+		row[4] = lo[0] & col;
+		row[5] = lo[1] & col;
+		row[6] = lo[2] & col;
+		row[7] = lo[3] & col;
+
+		row += LINE_SIZE;
+	}
+}
+
 static void scr_putc_col(int c, int col)
 {
-	int fnt_x, fnt_y;
 
 	switch (c) {
 		case '\n':
 			cur_x = 0;
 		case '\v':
 			cur_y += FNT_HEIGHT;
-			if (cur_y > SCR_HEIGHT)
-				cur_y = 0;
 		case '\0':
 		case '\r':
 			break;
@@ -48,22 +113,30 @@ static void scr_putc_col(int c, int col)
 			if (cur_x + FNT_WIDTH > SCR_WIDTH) {
 				cur_x = 0;
 				cur_y += FNT_HEIGHT;
-				if (cur_y < 0)
-					cur_y = 0;
 			}
 
-			for (fnt_x = 0; fnt_x < FNT_WIDTH; fnt_x++)
-				for (fnt_y = 0; fnt_y < FNT_HEIGHT; fnt_y++)
-					vram[cur_y + fnt_y][cur_x + fnt_x]
-						= (0x80 >> fnt_x) & fnt[c][fnt_y] ? col : 0;
+			// Scroll only once there is something to show on the new
+			// line, so that a final newline keeps the whole screen
+			while (cur_y + FNT_HEIGHT > SCR_HEIGHT)
+				scr_scroll();
+
+			scr_dirty |= 1 << (cur_y / FNT_HEIGHT);
+			scr_draw_glyph(c, col);
 
 			cur_x += FNT_WIDTH;
 	}
 }
 
-static void scr_putc(int c)
+// Fans each formatted span out to the debug log and the screen
+static void scr_sink(const char *s, size_t n, void *arg)
 {
-	scr_putc_col(c, 0x00FFFFFF);
+	dbg_write(s, n);
+
+	while (n > 0) {
+		scr_putc_col(*s, 0x00FFFFFF);
+		s++;
+		n--;
+	}
 }
 
 void scr_puts_col(const char *s, int col)
@@ -85,6 +158,7 @@ void scr_puts_col(const char *s, int col)
 
 void scr_printf(const char *fmt, ...)
 {
+	char buf[FORMAT_BUF_SIZE];
 	va_list va;
 
 	if (fmt == NULL) {
@@ -93,8 +167,7 @@ void scr_printf(const char *fmt, ...)
 	}
 
 	va_start(va, fmt);
-	dbg_vprintf(fmt, va);
-	_vfprintf(scr_putc, fmt, va);
+	_vformat(buf, sizeof(buf), scr_sink, NULL, fmt, va);
 	va_end(va);
 }
 
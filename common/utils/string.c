@@ -1,15 +1,34 @@
 #include <common/utils/ctype.h>
 #include <common/utils/string.h>
 
-static char *_sprintf_dst;
+// Words that may alias anything, and ones that may also be misaligned,
+// which GCC accesses with lwl/lwr
+typedef unsigned int __attribute__((may_alias)) word_t;
+typedef struct {
+	unsigned int w;
+} __attribute__((packed, may_alias)) uword_t;
 
 // Sets a memory region to a specific value
 void *memset(void *s, int c, size_t n)
 {
-	char *p;
+	unsigned char *p = s;
+	word_t w;
+
+	for (; n && ((unsigned int)p & 3); n--)
+		*p++ = c;
+
+	w = (unsigned char)c * 0x01010101;
+	for (; n >= 16; n -= 16, p += 16) {
+		((word_t *)p)[0] = w;
+		((word_t *)p)[1] = w;
+		((word_t *)p)[2] = w;
+		((word_t *)p)[3] = w;
+	}
+	for (; n >= 4; n -= 4, p += 4)
+		*(word_t *)p = w;
 
-	for(p = s; (int)p < (int)s + n; p++)
-		*p = c;
+	for (; n; n--)
+		*p++ = c;
 
 	return s;
 }
@@ -17,16 +36,52 @@ void *memset(void *s, int c, size_t n)
 // Copies one memory buffer into another
 void *memcpy(void *dst, const void *src, size_t n)
 {
-	char *p;
-
-	for(p = (char *)dst; (int)p < (int)dst + n; p++) {
-		*p = *(char *)src;
-		src++;
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+
+	// Align the destination, so that only the loads may be misaligned
+	for (; n && ((unsigned int)d & 3); n--)
+		*d++ = *s++;
+
+	if ((unsigned int)s & 3) {
+		for (; n >= 16; n -= 16, d += 16, s += 16) {
+			((word_t *)d)[0] = ((const uword_t *)s)[0].w;
+			((word_t *)d)[1] = ((const uword_t *)s)[1].w;
+			((word_t *)d)[2] = ((const uword_t *)s)[2].w;
+			((word_t *)d)[3] = ((const uword_t *)s)[3].w;
+		}
+		for (; n >= 4; n -= 4, d += 4, s += 4)
+			*(word_t *)d = ((const uword_t *)s)->w;
+	} else {
+		for (; n >= 16; n -= 16, d += 16, s += 16) {
+			((word_t *)d)[0] = ((const word_t *)s)[0];
+			((word_t *)d)[1] = ((const word_t *)s)[1];
+			((word_t *)d)[2] = ((const word_t *)s)[2];
+			((word_t *)d)[3] = ((const word_t *)s)[3];
+		}
+		for (; n >= 4; n -= 4, d += 4, s += 4)
+			*(word_t *)d = *(const word_t *)s;
 	}
 
+	for (; n; n--)
+		*d++ = *s++;
+
 	return dst;
 }
 
+// Compares two memory buffers, returns 0 if both equal
+int memcmp(const void *s1, const void *s2, size_t n)
+{
+	const unsigned char *a = s1;
+	const unsigned char *b = s2;
+
+	for (; n; n--, a++, b++)
+		if (*a != *b)
+			return *a - *b;
+
+	return 0;
+}
+
 //Scan s for the character.  When this loop is finished,
 //    s will either point to the end of the string or the
 //    character we were looking for
@@ -117,81 +172,135 @@ size_t strlen(const char *s)
  * Basic Sprintf functions
  */ 
 
-static void _itoa(unsigned val, void (* f)(int), int base, int w)
+typedef struct {
+	char *buf;
+	size_t size;
+	size_t len;
+	size_t total;
+	FormatSink sink;
+	void *arg;
+} FormatState;
+
+// Appends a span, handing the buffer to the sink whenever it fills up
+static void _emit(FormatState *st, const char *s, size_t n)
+{
+	size_t room;
+
+	while (n > 0) {
+		room = st->size - 1 - st->len;
+		if (room == 0) {
+			if (st->sink == NULL)
+				return;
+
+			st->buf[st->len] = '\0';
+			st->sink(st->buf, st->len, st->arg);
+			st->total += st->len;
+			st->len = 0;
+			continue;
+		}
+
+		if (room > n)
+			room = n;
+
+		memcpy(st->buf + st->len, s, room);
+		st->len += room;
+		s += room;
+		n -= room;
+	}
+}
+
+static int _itoa(unsigned val, char *buf, int base, int w)
 {
-	char buf[10];
+	char tmp[10];
 	int i = 0;
+	int n = 0;
 	int rem;
 
 	do {
 		rem = val % base;
-		buf[i++] = (rem < 10 ? 0x30 : 0x37) + rem;
+		tmp[i++] = (rem < 10 ? 0x30 : 0x37) + rem;
 		val /= base;
 		w--;
 	} while (val || w > 0);
 
 	while (i > 0)
-		f(buf[--i]);
+		buf[n++] = tmp[--i];
+
+	return n;
 }
 
-void _vfprintf(void (* f)(int), const char *fmt, va_list va)
+int _vformat(char *buf, size_t size, FormatSink sink, void *arg,
+	const char *fmt, va_list va)
 {
+	FormatState st;
 	const char *p;
+	char num[11];
 	char c, w;
-	int val;
+	int i, val;
+
+	st.buf = buf;
+	st.size = size;
+	st.len = 0;
+	st.total = 0;
+	st.sink = sink;
+	st.arg = arg;
 
-	while ((c = *fmt++) != '\0') {
+	while ((c = *fmt) != '\0') {
 		if (c != '%') {
-			f(c);
-		} else {
-			c = *fmt++;
+			for (i = 1; fmt[i] != '%' && fmt[i]; i++);
+			_emit(&st, fmt, i);
+			fmt += i;
+			continue;
+		}
 
-			w = 0;
-			if (c == '0') {
+		fmt++;
+		c = *fmt++;
+		if (c == '\0')
+			break;
+
+		w = 0;
+		if (c == '0') {
+			c = *fmt++;
+			if (c >= '0' && c <= '8') {
+				w = c - '0';
 				c = *fmt++;
-				if (c >= '0' && c <= '8') {
-					w = c - '0';
-					c = *fmt++;
-				}
 			}
+		}
 
-			switch (c) {
-				case 'd':
-					val = va_arg(va, int);
-					if (val < 0) {
-						f('-');
-						val = -val;
-					}
-					_itoa((unsigned)val, f, 10, w);
-					break;
-				case 'X' : 
-					_itoa((unsigned)va_arg(va, int), f, 16, w);
-					break;
-				case 's' :
-					p = va_arg(va, const char *);
-					while (*p != '\0')
-						f(*p++);
-					break;
-			}
+		switch (c) {
+			case 'd':
+				val = va_arg(va, int);
+				if (val < 0) {
+					num[0] = '-';
+					i = 1 + _itoa((unsigned)-val, num + 1, 10, w);
+				} else
+					i = _itoa((unsigned)val, num, 10, w);
+				_emit(&st, num, i);
+				break;
+			case 'X' :
+				i = _itoa((unsigned)va_arg(va, int), num, 16, w);
+				_emit(&st, num, i);
+				break;
+			case 's' :
+				p = va_arg(va, const char *);
+				_emit(&st, p, strlen(p));
+				break;
 		}
 	}
-}
 
-static void _sprintf_write(int s)
-{
-	*_sprintf_dst++ = s;
+	st.buf[st.len] = '\0';
+	if (st.sink != NULL && st.len > 0)
+		st.sink(st.buf, st.len, st.arg);
+
+	return st.total + st.len;
 }
 
 void _sprintf(char *s, const char *fmt, ...)
 {
 	va_list va;
 
-	_sprintf_dst = s;
-
 	va_start(va, fmt);
-	_vfprintf(_sprintf_write, fmt, va);
+	// No size is known, so let the formatter run to the end of memory
+	_vformat(s, (size_t)-1, NULL, NULL, fmt, va);
 	va_end(va);
-
-	*_sprintf_dst = '\0';
 }
-
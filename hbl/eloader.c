@@ -3,12 +3,19 @@
 #include <common/utils/string.h>
 #include <common/debug.h>
 #include <common/globals.h>
+#include <common/ledger.h>
 #include <common/memory.h>
 #include <common/path.h>
+#include <common/scratch.h>
 #include <common/sdk.h>
+#include <common/trace.h>
 #include <common/utils.h>
+#include <hbl/modmgr/memindex.h>
 #include <hbl/modmgr/modmgr.h>
 #include <hbl/stubs/hook.h>
+#ifdef HOOK_PROFILE
+#include <hbl/stubs/hookprof.h>
+#endif
 #include <hbl/eloader.h>
 #include <hbl/settings.h>
 #include <config.h>
@@ -22,16 +29,37 @@ int num_pend_th = 0;
 int num_run_th = 0;
 int num_exit_th = 0;
 
+SceUID exit_evf = -1;
+
+// How often wait_for_eboot_end looks by itself, in microseconds
+#define EXIT_POLL_INTERVAL 250000
+
 SceCtrlData pad;
 
+#if defined(DEBUG) && !defined(DEBUG_SYNC)
+static char dbgLog[DBG_LOG_SIZE];
+#endif
+#ifdef TRACE
+static TraceRecord traceLog[TRACE_MAX];
+#endif
+static LedgerEntry allocs[LEDGER_MAX];
+static MemIndexEntry memIndex[MEMINDEX_MAX];
+
 static void cleanup()
 {
 	threads_cleanup();
+	files_cleanup();
 	ram_cleanup();
+#ifdef HOOK_PROFILE
+	hook_profile_report();
+#endif
 
 	unload_modules();
 
 	hook_exit_cb = NULL;
+
+	dbg_flush();
+	trace_flush();
 }
 
 static int run_eboot(const char *path)
@@ -113,6 +141,8 @@ static int run_eboot(const char *path)
 	}
 
 	dbg_printf("%s: Success\n", __func__);
+	dbg_flush();
+	trace_flush();
 
 	return 0;
 }
@@ -128,41 +158,40 @@ static int call_hook_exit_cb()
 
 static void wait_for_eboot_end()
 {
-	while (num_run_th > 0) {
-		//sceKernelWaitSema(gthSema, 1, 0);
-
-		//Check for force exit to the menu
-		if (isImported(sceCtrlReadBufferPositive))
-			sceCtrlReadBufferPositive(&pad, 1);
-		else if (isImported(sceCtrlPeekBufferPositive))
-			sceCtrlPeekBufferPositive(&pad, 1);
-
-		if (force_exit_buttons && pad.Buttons == force_exit_buttons)
-			break;
+	SceUInt timeout;
+	u32 bits;
+
+	while (num_run_th > 0 && !_hook_sceKernelExitGame_IsCalled) {
+		// The thread, exit and pad hooks wake us up
+		if (exit_evf >= 0) {
+			timeout = EXIT_POLL_INTERVAL;
+			if (sceKernelWaitEventFlag(exit_evf, EXIT_EVF_ALL,
+				PSP_EVENT_WAITOR | PSP_EVENT_WAITCLEAR,
+				&bits, &timeout) >= 0)
+			{
+				if (bits & EXIT_EVF_BUTTONS)
+					break;
+
+				continue;
+			}
+		} else
+			sceKernelDelayThread(16384);
 
-		if (_hook_sceKernelExitGame_IsCalled)
+		//Check for force exit to the menu, in case the homebrew
+		//reads the pad in a way the hooks don't see
+		if (sample_pad(&pad))
 			break;
-
-		//sceKernelSignalSema(gthSema, 1);
-
-		sceKernelDelayThread(16384);
 	}
 
 	exit_everything();
 	_hook_sceKernelExitGame_IsCalled = 0;
+	if (exit_evf >= 0)
+		sceKernelClearEventFlag(exit_evf, 0);
 
 	scr_init();
 	dbg_printf("Threads are dead\n");
 }
 
-static void ramcheck(int expected_free_ram) {
-	int free_ram = hblKernelTotalFreeMemSize();
-
-	if (expected_free_ram > free_ram)
-		scr_printf("WARNING! Memory leak: %d -> %d\n",
-			expected_free_ram, free_ram);
-}
-
 // HBL exit callback
 static int hbl_exit_callback() __attribute__((noreturn));
 static int hbl_exit_callback()
@@ -170,6 +199,8 @@ static int hbl_exit_callback()
 	dbg_printf("HBL Exit Callback Called\n");
 	kill_thread(globals->hblThread);
 	hbl_exit_callback_IsCalled = 1;
+	dbg_flush();
+	trace_flush();
 	hblExitGameWithStatus(call_hook_exit_cb());
 }
 
@@ -199,7 +230,6 @@ int module_start()
 {
 	char path[260];
 	int exit = 0;
-	int init_free;
 	int thid;
 
 #ifdef LAUNCHER
@@ -207,6 +237,21 @@ int module_start()
 	UnloadModules();
 #endif
 
+	dbg_log_init(dbgLog, sizeof(dbgLog));
+	trace_init(traceLog, TRACE_MAX);
+	ledger_init(allocs, LEDGER_MAX);
+	memindex_init(memIndex, MEMINDEX_MAX);
+	if (scratch_init(SCRATCH_SIZE) < 0)
+		dbg_printf("Scratch arena unavailable, using separate blocks\n");
+
+	if (isImported(sceKernelCreateEventFlag)
+		&& isImported(sceKernelWaitEventFlag)
+		&& isImported(sceKernelSetEventFlag)
+		&& isImported(sceKernelClearEventFlag))
+	{
+		exit_evf = sceKernelCreateEventFlag("HBLexitevf", 0, 0, NULL);
+	}
+
 	scr_puts("Creating callback thread");
 	thid = sceKernelCreateThread("HBLexitcbthread", callback_thread, 0x11, 0xFA0, THREAD_ATTR_USER, NULL);
 	if(thid > -1) {
@@ -218,24 +263,20 @@ int module_start()
 	}
 	//...otherwise launch the menu
 	while (!exit) {
-		init_free = hblKernelTotalFreeMemSize();
-
 		scr_puts("Loading global configurations");
 		loadGlobalConfig();
 
 		scr_puts("Running " EBOOT_PATH);
 		if (run_eboot(EBOOT_PATH)) {
-			ramcheck(init_free);
+			ram_cleanup();
 			break;
 		}
 		wait_for_eboot_end();
 
 		cleanup();
-		ramcheck(init_free);
 		if (!strcmp("quit", hb_fname))
 			break;
 		strcpy(path, hb_fname);
-		init_free = hblKernelTotalFreeMemSize();
 
 		scr_puts("Loading global configurations");
 		loadGlobalConfig();
@@ -243,13 +284,12 @@ int module_start()
 		//run homebrew
 		scr_printf("Running %s", path);
 		if (run_eboot(path)) {
-			ramcheck(init_free);
+			ram_cleanup();
 			continue;
 		}
 		wait_for_eboot_end();
 
 		cleanup();
-		ramcheck(init_free);
 	}
 
 	scr_puts("Exiting");
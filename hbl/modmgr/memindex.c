@@ -0,0 +1,116 @@
+#include <stddef.h>
+#include <common/utils/string.h>
+#include <common/debug.h>
+#include <common/sdk.h>
+#include <common/utils.h>
+#include <hbl/modmgr/elf.h>
+#include <hbl/modmgr/memindex.h>
+
+static MemIndexEntry *mem_index = NULL;
+static unsigned mem_index_max = 0;
+static unsigned mem_index_num = 0;
+
+// Returns !=0 if info looks like the module info of the named module
+static int check_modinfo(const SceModuleInfo *info, const char *module)
+{
+	const char *ent_top = info->ent_top;
+	const char *ent_end = info->ent_end;
+	const char *stub_top = info->stub_top;
+	const char *stub_end = info->stub_end;
+
+	return !((uintptr_t)info & 3) && !strcmp(info->modname, module)
+		&& valid_umem_pointer(ent_top) && valid_umem_pointer(ent_end)
+		&& ent_top <= ent_end && ent_end - ent_top <= 4096
+		&& valid_umem_pointer(stub_top) && valid_umem_pointer(stub_end)
+		&& stub_top <= stub_end && stub_end - stub_top <= 4096
+		&& !((stub_end - stub_top) % sizeof(tStubEntry));
+}
+
+// Returns !=0 if the entry still describes a loaded module
+static int check_entry(const MemIndexEntry *entry)
+{
+	return sceKernelGetModuleIdByAddress((u32)entry->info) == entry->modid;
+}
+
+static void drop(unsigned i)
+{
+	mem_index_num--;
+	mem_index[i] = mem_index[mem_index_num];
+}
+
+void memindex_init(MemIndexEntry *table, unsigned max)
+{
+	// Without the module ID of an address, entries could outlive their
+	// module unnoticed
+	if (!isImported(sceKernelGetModuleIdByAddress))
+		return;
+
+	mem_index = table;
+	mem_index_max = max;
+	mem_index_num = 0;
+}
+
+const SceModuleInfo *memindex_find(const char *module)
+{
+	unsigned i;
+
+	for (i = 0; i < mem_index_num; i++)
+		if (!strcmp(mem_index[i].info->modname, module)) {
+			if (check_entry(mem_index + i))
+				return mem_index[i].info;
+
+			drop(i);
+			break;
+		}
+
+	return NULL;
+}
+
+const SceModuleInfo *memindex_add(const char *module)
+{
+	const SceModuleInfo *info;
+	const char *p, *end;
+	SceUID modid;
+
+	if (mem_index == NULL)
+		return NULL;
+
+	info = memindex_find(module);
+	if (info != NULL)
+		return info;
+
+	if (mem_index_num >= mem_index_max) {
+		dbg_printf("!!! EXCEEDED MEMORY INDEX, not remembering %s\n", module);
+		return NULL;
+	}
+
+	p = (void *)GAME_MEMORY_START;
+	end = (void *)0x0A000000;
+	while ((p = findstr(module, p, end - p)) != NULL) {
+		info = (void *)(p - offsetof(SceModuleInfo, modname));
+		if (check_modinfo(info, module)) {
+			modid = sceKernelGetModuleIdByAddress((u32)info);
+			if (modid >= 0) {
+				mem_index[mem_index_num].info = info;
+				mem_index[mem_index_num].modid = modid;
+				mem_index_num++;
+				return info;
+			}
+		}
+
+		p++;
+	}
+
+	return NULL;
+}
+
+void memindex_prune()
+{
+	unsigned i = 0;
+
+	while (i < mem_index_num)
+		if (check_entry(mem_index + i))
+			i++;
+		else
+			drop(i);
+}
@@ -4,11 +4,15 @@
 #include <common/utils/string.h>
 #include <common/debug.h>
 #include <common/globals.h>
+#include <common/ledger.h>
 #include <common/memory.h>
 #include <common/path.h>
 #include <common/prx.h>
+#include <common/scratch.h>
 #include <common/sdk.h>
+#include <common/trace.h>
 #include <hbl/modmgr/elf.h>
+#include <hbl/modmgr/memindex.h>
 #include <hbl/modmgr/modmgr.h>
 #include <hbl/stubs/hook.h>
 #include <hbl/stubs/resolve.h>
@@ -120,6 +124,52 @@ static void log_mod_entry(HBLModInfo modinfo)
 }
 #endif
 
+// Relocatable modules are placed on 64kB boundaries
+#define MODULE_ALIGN (1 << 16)
+
+/*
+ * Finds an aligned address for a relocatable module without allocating
+ * more than it needs. Modules go to the top of the partition so the space
+ * below stays in one piece for the homebrew heap.
+ */
+static SceUID modmgrAllocAligned(const char *name, SceSize size, void **p)
+{
+	SceSize largest;
+	SceUID blockid;
+	u32 head, addr;
+
+	// Firmwares that know aligned allocations do the work for us
+	blockid = ledger_alloc(LEDGER_HOMEBREW, name,
+		PSP_SMEM_HighAligned, size, (void *)MODULE_ALIGN);
+	if (blockid >= 0) {
+		*p = sceKernelGetBlockHeadAddr(blockid);
+		return blockid;
+	}
+
+	dbg_printf("Aligned allocation failed: 0x%08X\n", blockid);
+
+	// Otherwise locate the largest free region and take its highest
+	// aligned address that still fits the module
+	largest = hblKernelMaxFreeMemSize();
+	if (largest < size)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+
+	blockid = sceKernelAllocPartitionMemory(2, "ValentineFreeMemMalloc",
+		PSP_SMEM_Low, largest, NULL);
+	if (blockid < 0)
+		return blockid;
+
+	head = (u32)sceKernelGetBlockHeadAddr(blockid);
+	sceKernelFreePartitionMemory(blockid);
+
+	addr = (head + largest - size) & ~(MODULE_ALIGN - 1);
+	if (addr < head)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+
+	*p = (void *)addr;
+	return ledger_alloc(LEDGER_HOMEBREW, name, PSP_SMEM_Addr, size, *p);
+}
+
 static void *modmgrMalloc(const char *name, SceSize size, void *p)
 {
 	SceUID blockid;
@@ -129,26 +179,19 @@ static void *modmgrMalloc(const char *name, SceSize size, void *p)
 	if (name == NULL)
 		return NULL;
 
-	if (p == NULL) {
-		blockid = _hook_sceKernelAllocPartitionMemory(2, name,
-			PSP_SMEM_Low, size + (1 << 16), NULL);
-		if (blockid < 0) {
-			dbg_printf("FAILED: 0x%08X\n", blockid);
-			return NULL;
-		}
-
-		p = sceKernelGetBlockHeadAddr(blockid);
-		if ((int)p & ((1 << 16) - 1))
-			p = (void *)(((int)p & ~((1 << 16) - 1)) + (1 << 16));
-	} else {
-		blockid = _hook_sceKernelAllocPartitionMemory(2, name,
+	if (p == NULL)
+		blockid = modmgrAllocAligned(name, size, &p);
+	else
+		blockid = ledger_alloc(LEDGER_HOMEBREW, name,
 			PSP_SMEM_Addr, size, p);
-		if (blockid < 0) {
-			dbg_printf("FAILED: 0x%08X\n", blockid);
-			return NULL;
-		}
+
+	if (blockid < 0) {
+		dbg_printf("FAILED: 0x%08X\n", blockid);
+		return NULL;
 	}
 
+	dbg_printf("-> 0x%08X\n", (int)p);
+
 	return p;
 }
 
@@ -159,7 +202,6 @@ SceUID load_module(SceUID fd, const char *path, void *addr, SceOff off)
 	Elf32_Ehdr ehdr;
 	Elf32_Phdr *phdrs;
 	tStubEntry *stubs;
-	SceUID phdrs_block;
 	SceUID modid = mod_loaded_num;
 	size_t phdrs_size, mod_size, stubs_size;
 	int i, ret;
@@ -204,18 +246,9 @@ SceUID load_module(SceUID fd, const char *path, void *addr, SceOff off)
 
 	phdrs_size = ehdr.e_phentsize * ehdr.e_phnum;
 
-	ret = sceKernelAllocPartitionMemory(
-		2, "HBL Module Program Headers", PSP_SMEM_High, phdrs_size, NULL);
-	if (ret < 0)
-		goto fail;
-	else
-		phdrs_block = ret;
-
-	phdrs = sceKernelGetBlockHeadAddr(phdrs_block);
-	if (phdrs == NULL) {
-		ret = SCE_KERNEL_ERROR_ERROR;
-		goto fail;
-	}
+	phdrs = scratch_alloc(phdrs_size);
+	if (phdrs == NULL)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
 
 	ret = sceIoLseek(fd, off + ehdr.e_phoff, PSP_SEEK_SET);
 	if (ret < 0)
@@ -294,6 +327,7 @@ SceUID load_module(SceUID fd, const char *path, void *addr, SceOff off)
 
 	mod_loaded_num++;
 	//dbg_printf("Module table updated\n");
+	trace_event(TRACE_MODULE_LOAD, modid, (u32)addr, mod_size);
 
 	dbg_printf("\n->Actual number of loaded modules: %d\n", mod_loaded_num);
 	dbg_printf("Last loaded module [%d]:\n", modid);
@@ -305,7 +339,7 @@ SceUID load_module(SceUID fd, const char *path, void *addr, SceOff off)
 
 	ret = modid;
 fail:
-	sceKernelFreePartitionMemory(phdrs_block);
+	scratch_reset();
 	return ret;
 }
 
@@ -387,6 +421,8 @@ SceUID start_module(SceUID modid)
 	dbg_printf("->MODULE MAIN THID: 0x%08X ", thid);
 	//The hook is called here to handle thread monitoring
 	thid = _hook_sceKernelStartThread(thid, arglen, argp);
+	trace_event(TRACE_MODULE_START, modid,
+		(u32)mod_table[modid].text_entry, thid);
 	if (thid < 0) {
 		dbg_printf(" HB Thread couldn't start. Error 0x%08X\n", thid);
 		return thid;
@@ -460,7 +496,7 @@ static int load_util(int module)
 }
 
 #ifndef DISABLE_UNLOAD_UTILITY_MODULES
-static int unload_util(int module)
+static int unload_util_module(int module)
 {
 #ifdef UTILITY_UNLOAD_MODULE_FILE
 	int ret;
@@ -487,6 +523,18 @@ static int unload_util(int module)
 		return SCE_KERNEL_ERROR_ERROR;
 #endif
 }
+
+static int unload_util(int module)
+{
+	int ret;
+
+	ret = unload_util_module(module);
+
+	// Only the modules that went away are forgotten
+	memindex_prune();
+
+	return ret;
+}
 #endif
 
 #ifndef DISABLE_UNLOAD_UTILITY_MODULES
@@ -524,6 +572,7 @@ void unload_modules()
 {
 #ifdef DISABLE_UNLOAD_UTILITY_MODULES
 	UnloadModules();
+	memindex_prune();
 #else
 	//unload utility modules
 	int i, ret;
@@ -621,6 +670,26 @@ static SceLibraryEntryTable *find_exports(const char *module, const char *lib)
 {
 	// Search for module name
 	char *p, *foundModule;
+	const SceModuleInfo *info;
+	const SceLibraryEntryTable *exports;
+	const char *ent;
+
+	// The module was just loaded, so only its own exports are looked at
+	info = memindex_add(module);
+	if (info != NULL) {
+		for (ent = info->ent_top; ent < (char *)info->ent_end;
+			ent += exports->len * 4)
+		{
+			exports = (void *)ent;
+			if (exports->len < 4)
+				break;
+
+			if (exports->libname != NULL && !strcmp(exports->libname, lib))
+				return (void *)exports;
+		}
+
+		return NULL;
+	}
 
 	foundModule = (void *)GAME_MEMORY_START;
 	do {
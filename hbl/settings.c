@@ -17,6 +17,11 @@ int override_sceIoMkdir = DONT_OVERRIDE;
 int override_sceCtrlPeekBufferPositive = DONT_OVERRIDE;
 int return_to_xmb_on_exit = 0;
 unsigned int force_exit_buttons = 0;
+int alloc_fallback_percent = ALLOC_FALLBACK_PERCENT;
+int alloc_pool_threshold = ALLOC_POOL_THRESHOLD;
+int io_readahead = IO_READAHEAD;
+int io_writebehind = IO_WRITEBEHIND;
+int io_dircache = IO_DIRCACHE;
 char hb_fname[512] = "ms0:/PSP/GAME/";
 
 /*****************************************************************************/
@@ -244,6 +249,26 @@ void configGetProcessingOptions()
         {
             force_exit_buttons = configAddrParse(lval);
         }
+        else if (strcmp(lstr,"alloc_fallback_percent")==0)
+        {
+            alloc_fallback_percent = configIntParse(lval);
+        }
+        else if (strcmp(lstr,"alloc_pool_threshold")==0)
+        {
+            alloc_pool_threshold = configIntParse(lval);
+        }
+        else if (strcmp(lstr,"io_readahead")==0)
+        {
+            io_readahead = configIntParse(lval);
+        }
+        else if (strcmp(lstr,"io_writebehind")==0)
+        {
+            io_writebehind = configIntParse(lval);
+        }
+        else if (strcmp(lstr,"io_dircache")==0)
+        {
+            io_dircache = configIntParse(lval);
+        }
         else if (strcmp(lstr,"hb_folder")==0)
         {
             //note: hb_folder is initialized in loadGlobalConfig
@@ -260,6 +285,13 @@ void configGetProcessingOptions()
 // Load default config
 void loadGlobalConfig()
 {
+	// Per-homebrew settings must not leak into the next homebrew
+	alloc_fallback_percent = ALLOC_FALLBACK_PERCENT;
+	alloc_pool_threshold = ALLOC_POOL_THRESHOLD;
+	io_readahead = IO_READAHEAD;
+	io_writebehind = IO_WRITEBEHIND;
+	io_dircache = IO_DIRCACHE;
+
 	loadConfig(HBL_ROOT HBL_CONFIG);
 	dbg_printf("%s: Success\n", __func__);
 }
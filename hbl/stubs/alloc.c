@@ -0,0 +1,40 @@
+#include <common/sdk.h>
+#include <hbl/stubs/alloc.h>
+
+/*
+ * Bisection needs about 2 * log2((size - min) / 256) syscalls, where
+ * stepping down 10kB at a time needed hundreds for big requests.
+ */
+SceUID alloc_fallback(SceUID partitionid, const char *name, int type,
+	SceSize *size, void *addr, SceSize min)
+{
+	SceSize lo, hi, mid;
+	SceUID uid;
+
+	// If even the floor fails, don't bother searching
+	uid = sceKernelAllocPartitionMemory(partitionid, name, type, min, addr);
+	if (uid <= 0)
+		return uid;
+
+	// lo is known to fit, hi is known not to. Each probe must run with
+	// nothing held, since the held block may sit in the region it needs.
+	lo = min;
+	hi = *size;
+	while (hi - lo > PARTITION_GRANULARITY) {
+		if (uid > 0)
+			sceKernelFreePartitionMemory(uid);
+
+		mid = lo + (hi - lo) / 2;
+		uid = sceKernelAllocPartitionMemory(partitionid, name, type, mid, addr);
+		if (uid > 0)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	if (uid <= 0)
+		uid = sceKernelAllocPartitionMemory(partitionid, name, type, lo, addr);
+
+	*size = lo;
+	return uid;
+}
@@ -0,0 +1,502 @@
+#include <common/utils/string.h>
+#include <common/debug.h>
+#include <common/globals.h>
+#include <common/ledger.h>
+#include <common/memory.h>
+#include <common/sdk.h>
+#include <hbl/stubs/bufio.h>
+#include <hbl/stubs/hook.h>
+#include <hbl/settings.h>
+
+/*
+ * Buffering for homebrew that reads or writes files a few bytes at a time.
+ *
+ * Files opened read-only get a read-ahead window holding the file contents
+ * from base to base + len. pos is the position the homebrew sees and kpos
+ * the one of the kernel descriptor, which only moves on refills.
+ *
+ * Files opened for writing get a write-behind buffer holding len bytes
+ * to be written at the kernel position. Anything else done with the
+ * descriptor flushes it first, so the kernel position stays authoritative.
+ *
+ * A thread claims an entry by setting busy under ioSema, and works on it
+ * unlocked until it releases it. Others wait for the claim, so reads,
+ * writes, seeks and closes of one descriptor never overlap.
+ */
+typedef struct {
+	SceUID fd;	// 0 if the entry is unused
+	SceUID block;
+	int write;
+	int busy;
+	char *buf;
+	SceSize size;
+	SceSize len;
+	SceOff base;
+	SceOff pos;
+	SceOff kpos;
+} BufFile;
+
+static BufFile files[BUFIO_MAX];
+
+// Must be called with ioSema locked
+static BufFile *bufio_find(SceUID fd)
+{
+	int i;
+
+	for (i = 0; i < BUFIO_MAX; i++)
+		if (files[i].fd == fd)
+			return files + i;
+
+	return NULL;
+}
+
+// Claims the entry of a descriptor, waiting while another thread has it.
+// Returns NULL if the descriptor is not buffered.
+static BufFile *bufio_acquire(SceUID fd)
+{
+	BufFile *file;
+	int state;
+
+	if (fd <= 0)
+		return NULL;
+
+	for (;;) {
+		state = hblLock(globals->ioSema);
+		file = bufio_find(fd);
+		if (file == NULL || !file->busy) {
+			if (file != NULL)
+				file->busy = 1;
+			hblUnlock(globals->ioSema, state);
+			return file;
+		}
+		hblUnlock(globals->ioSema, state);
+
+		sceKernelDelayThread(0);
+	}
+}
+
+static void bufio_release(BufFile *file)
+{
+	int state;
+
+	state = hblLock(globals->ioSema);
+	file->busy = 0;
+	hblUnlock(globals->ioSema, state);
+}
+
+// Only the Memory Stick and the internal storage are worth buffering.
+// Block devices such as umd0: are addressed by sector and left alone.
+static int bufio_device_ok(const char *path)
+{
+	int i;
+
+	for (i = 0; path[i] != ':'; i++)
+		if (path[i] == '\0' || path[i] == '/')
+			return 1;	// Relative to the homebrew directory
+
+	return i == 3 && (!strncmp(path, "ms0", 3) || !strncmp(path, "ef0", 3)
+		|| !strncmp(path, "MS0", 3) || !strncmp(path, "EF0", 3));
+}
+
+void bufio_open(SceUID fd, const char *path, int flags)
+{
+	BufFile *file;
+	SceUID block;
+	SceSize size;
+	void *buf;
+	int state;
+
+	if (fd <= 0 || !bufio_device_ok(path))
+		return;
+
+	size = flags & PSP_O_WRONLY ? io_writebehind : io_readahead;
+	if ((int)size <= 0)
+		return;
+
+	block = ledger_alloc(LEDGER_HOMEBREW, "HBL File Buffer",
+		PSP_SMEM_High, size, NULL);
+	if (block < 0)
+		return;
+
+	buf = sceKernelGetBlockHeadAddr(block);
+	if (buf == NULL) {
+		ledger_free(block);
+		return;
+	}
+
+	state = hblLock(globals->ioSema);
+	file = bufio_find(0);
+	if (file != NULL) {
+		file->fd = fd;
+		file->block = block;
+		file->write = flags & PSP_O_WRONLY;
+		file->busy = 0;
+		file->buf = buf;
+		file->size = size;
+		file->len = 0;
+		file->base = 0;
+		file->pos = 0;
+		file->kpos = 0;
+	}
+	hblUnlock(globals->ioSema, state);
+
+	if (file == NULL) {
+		dbg_printf("No file buffer left for 0x%08X\n", fd);
+		ledger_free(block);
+	}
+}
+
+// Writes out what the homebrew wrote since the last flush
+static int bufio_flush_file(BufFile *file)
+{
+	SceSize len;
+	int r;
+
+	if (!file->write || !file->len)
+		return 0;
+
+	// The data stays queued until the write returns, so that the exit
+	// flush still writes it if this thread is killed in the meantime
+	len = file->len;
+	r = sceIoWrite(file->fd, file->buf, len);
+	file->len = 0;
+	if (r < 0)
+		return r;
+
+	return r < len ? SCE_KERNEL_ERROR_ERROR : 0;
+}
+
+// Moves the kernel descriptor to where the homebrew expects it
+static int bufio_sync(BufFile *file)
+{
+	SceOff r;
+
+	if (file->kpos == file->pos)
+		return 0;
+
+	r = sceIoLseek(file->fd, file->pos, PSP_SEEK_SET);
+	if (r < 0)
+		return r;
+
+	file->kpos = r;
+	return 0;
+}
+
+int bufio_detach(SceUID fd)
+{
+	BufFile *file;
+	SceUID block;
+	int r, state;
+
+	file = bufio_acquire(fd);
+	if (file == NULL)
+		return 0;
+
+	r = file->write ? bufio_flush_file(file) : bufio_sync(file);
+
+	state = hblLock(globals->ioSema);
+	block = file->block;
+	file->fd = 0;
+	file->busy = 0;
+	hblUnlock(globals->ioSema, state);
+
+	ledger_free(block);
+
+	return r;
+}
+
+int bufio_flush(SceUID fd)
+{
+	BufFile *file;
+	int r;
+
+	file = bufio_acquire(fd);
+	if (file == NULL)
+		return 0;
+
+	r = bufio_flush_file(file);
+	bufio_release(file);
+
+	return r;
+}
+
+void bufio_flush_all()
+{
+	int i;
+
+	// The homebrew threads are gone by now, and one may have been killed
+	// holding an entry, so claims are dropped instead of waited for
+	for (i = 0; i < BUFIO_MAX; i++)
+		if (files[i].fd > 0) {
+			files[i].busy = 0;
+			bufio_flush_file(files + i);
+		}
+}
+
+void bufio_reset()
+{
+	int i;
+
+	for (i = 0; i < BUFIO_MAX; i++) {
+		files[i].fd = 0;
+		files[i].busy = 0;
+	}
+}
+
+static int bufio_read_file(BufFile *file, void *data, SceSize size)
+{
+	SceSize done, n;
+	int r;
+
+	if (file->write) {
+		r = bufio_flush_file(file);
+		if (r < 0)
+			return r;
+
+		return sceIoRead(file->fd, data, size);
+	}
+
+	done = 0;
+	while (done < size) {
+		// Serve what the window already holds
+		if (file->pos >= file->base && file->pos < file->base + file->len) {
+			n = file->base + file->len - file->pos;
+			if (n > size - done)
+				n = size - done;
+
+			memcpy((char *)data + done, file->buf + (file->pos - file->base), n);
+			file->pos += n;
+			done += n;
+			continue;
+		}
+
+		r = bufio_sync(file);
+		if (r < 0)
+			return done ? done : r;
+
+		// Big reads gain nothing from the window
+		if (size - done >= file->size) {
+			r = sceIoRead(file->fd, (char *)data + done, size - done);
+			if (r < 0)
+				return done ? done : r;
+
+			file->pos += r;
+			file->kpos = file->pos;
+			return done + r;
+		}
+
+		r = sceIoRead(file->fd, file->buf, file->size);
+		if (r < 0)
+			return done ? done : r;
+
+		file->base = file->pos;
+		file->len = r;
+		file->kpos = file->pos + r;
+
+		// End of file
+		if (r == 0)
+			break;
+	}
+
+	return done;
+}
+
+static int bufio_read(SceUID fd, void *data, SceSize size)
+{
+	BufFile *file;
+	int r;
+
+	file = bufio_acquire(fd);
+	if (file == NULL)
+		return sceIoRead(fd, data, size);
+
+	r = bufio_read_file(file, data, size);
+	bufio_release(file);
+
+	return r;
+}
+
+static SceOff bufio_lseek_file(BufFile *file, SceOff offset, int whence)
+{
+	SceOff r;
+
+	if (file->write) {
+		r = bufio_flush_file(file);
+		if (r < 0)
+			return r;
+
+		return sceIoLseek(file->fd, offset, whence);
+	}
+
+	switch (whence) {
+		case PSP_SEEK_SET:
+			break;
+
+		case PSP_SEEK_CUR:
+			offset += file->pos;
+			break;
+
+		default:
+			// Only the kernel knows the size of the file
+			r = sceIoLseek(file->fd, offset, whence);
+			if (r >= 0) {
+				file->pos = r;
+				file->kpos = r;
+			}
+			return r;
+	}
+
+	if (offset < 0)
+		return SCE_KERNEL_ERROR_ERRNO_INVALID_ARGUMENT;
+
+	file->pos = offset;
+	return offset;
+}
+
+static SceOff bufio_lseek(SceUID fd, SceOff offset, int whence)
+{
+	BufFile *file;
+	SceOff r;
+
+	file = bufio_acquire(fd);
+	if (file == NULL)
+		return sceIoLseek(fd, offset, whence);
+
+	r = bufio_lseek_file(file, offset, whence);
+	bufio_release(file);
+
+	return r;
+}
+
+static int bufio_write_file(BufFile *file, const void *data, SceSize size)
+{
+	int r;
+
+	if (!file->write) {
+		r = bufio_sync(file);
+		if (r < 0)
+			return r;
+
+		// The window no longer matches the file
+		file->len = 0;
+		r = sceIoWrite(file->fd, data, size);
+		if (r > 0)
+			file->kpos += r;
+		file->pos = file->kpos;
+		return r;
+	}
+
+	if (file->len + size > file->size) {
+		r = bufio_flush_file(file);
+		if (r < 0)
+			return r;
+	}
+
+	// Big writes gain nothing from the buffer
+	if (size >= file->size)
+		return sceIoWrite(file->fd, data, size);
+
+	memcpy(file->buf + file->len, data, size);
+	file->len += size;
+
+	return size;
+}
+
+static int bufio_write(SceUID fd, const void *data, SceSize size)
+{
+	BufFile *file;
+	int r;
+
+	file = bufio_acquire(fd);
+	if (file == NULL)
+		return sceIoWrite(fd, data, size);
+
+	r = bufio_write_file(file, data, size);
+	bufio_release(file);
+
+	return r;
+}
+
+int _hook_sceIoRead(SceUID fd, void *data, SceSize size)
+{
+#ifdef IO_PROFILE
+	u32 start = io_profile_clock();
+	int r = bufio_read(fd, data, size);
+
+	io_profile_add(fd, IO_PROFILE_READ, r, start);
+	return r;
+#else
+	return bufio_read(fd, data, size);
+#endif
+}
+
+int _hook_sceIoWrite(SceUID fd, const void *data, SceSize size)
+{
+#ifdef IO_PROFILE
+	u32 start = io_profile_clock();
+	int r = bufio_write(fd, data, size);
+
+	io_profile_add(fd, IO_PROFILE_WRITE, r, start);
+	return r;
+#else
+	return bufio_write(fd, data, size);
+#endif
+}
+
+SceOff _hook_sceIoLseek(SceUID fd, SceOff offset, int whence)
+{
+#ifdef IO_PROFILE
+	u32 start = io_profile_clock();
+	SceOff r = bufio_lseek(fd, offset, whence);
+
+	io_profile_add(fd, IO_PROFILE_SEEK, r < 0 ? r : 0, start);
+	return r;
+#else
+	return bufio_lseek(fd, offset, whence);
+#endif
+}
+
+int _hook_sceIoLseek32(SceUID fd, int offset, int whence)
+{
+	return _hook_sceIoLseek(fd, offset, whence);
+}
+
+/*
+ * Calls that the buffers do not model move the kernel position on their
+ * own, so the descriptor stops being buffered before they are passed on.
+ */
+int _hook_sceIoReadAsync(SceUID fd, void *data, SceSize size)
+{
+	bufio_detach(fd);
+	return sceIoReadAsync(fd, data, size);
+}
+
+int _hook_sceIoWriteAsync(SceUID fd, const void *data, SceSize size)
+{
+	bufio_detach(fd);
+	return sceIoWriteAsync(fd, data, size);
+}
+
+int _hook_sceIoLseekAsync(SceUID fd, SceOff offset, int whence)
+{
+	bufio_detach(fd);
+	return sceIoLseekAsync(fd, offset, whence);
+}
+
+int _hook_sceIoLseek32Async(SceUID fd, int offset, int whence)
+{
+	bufio_detach(fd);
+	return sceIoLseek32Async(fd, offset, whence);
+}
+
+int _hook_sceIoIoctl(SceUID fd, unsigned int cmd, void *indata, int inlen, void *outdata, int outlen)
+{
+	bufio_detach(fd);
+	return sceIoIoctl(fd, cmd, indata, inlen, outdata, outlen);
+}
+
+int _hook_sceIoIoctlAsync(SceUID fd, unsigned int cmd, void *indata, int inlen, void *outdata, int outlen)
+{
+	bufio_detach(fd);
+	return sceIoIoctlAsync(fd, cmd, indata, inlen, outdata, outlen);
+}
@@ -0,0 +1,406 @@
+#include <common/utils/ctype.h>
+#include <common/utils/string.h>
+#include <common/debug.h>
+#include <common/globals.h>
+#include <common/ledger.h>
+#include <common/memory.h>
+#include <common/sdk.h>
+#include <hbl/stubs/dircache.h>
+#include <hbl/settings.h>
+
+/*
+ * Listings are recorded while the homebrew enumerates a directory, and
+ * served from memory the next time it is opened. Each entry is packed in
+ * the buffer as its SceIoStat, then its name with the terminator.
+ *
+ * Synthetic UIDs are DIRCACHE_UID_TAG | handle. Kernel UIDs never have
+ * these high bits.
+ *
+ * Long names (d_private) are not recorded. A reader that asks for them
+ * is moved to a kernel descriptor at the same position.
+ */
+#define DIRCACHE_UID_TAG 0x7E000000
+#define DIRCACHE_UID_MASK 0xFF000000
+
+typedef struct {
+	SceUID block;	// Partition block, 0 if the entry is unused
+	char *buf;
+	SceSize size;
+	SceSize len;
+	SceUID fill;	// Descriptor being recorded, 0 once complete
+	int stale;	// Freed when the last reader closes it
+	unsigned users;	// Synthetic UIDs reading it
+	unsigned stamp;	// Last use
+	unsigned dots;	// Leading entries made up by sceIoDread_Vita
+	char path[DIRCACHE_PATH_LEN];
+} CachedDir;
+
+typedef struct {
+	CachedDir *dir;	// NULL if the handle is unused
+	SceSize pos;
+	unsigned index;	// Entries read
+	SceUID kfd;	// Kernel descriptor reading instead, or 0
+} DirHandle;
+
+static CachedDir dirs[DIRCACHE_MAX];
+static DirHandle handles[DIRCACHE_HANDLES];
+static unsigned dirClock = 0;
+
+static int isAbsolute(const char *path)
+{
+	return strchr(path, ':') != NULL;
+}
+
+// Whether one path is the start of the other, ignoring case
+static int isPrefix(const char *a, const char *b)
+{
+	for (; *a && *b; a++, b++)
+		if (toupper(*a) != toupper(*b))
+			return 0;
+
+	return 1;
+}
+
+// Returns the handle of a synthetic UID, or NULL.
+// Must be called with ioSema locked.
+static DirHandle *dircache_handle(SceUID fd)
+{
+	unsigned i;
+
+	if ((fd & DIRCACHE_UID_MASK) != DIRCACHE_UID_TAG)
+		return NULL;
+
+	i = fd & ~DIRCACHE_UID_MASK;
+	if (i >= DIRCACHE_HANDLES || handles[i].dir == NULL)
+		return NULL;
+
+	return handles + i;
+}
+
+// Unlinks a listing, returning the block to free once unlocked, or 0.
+// Must be called with ioSema locked.
+static SceUID dircache_drop(CachedDir *dir)
+{
+	SceUID block;
+
+	dir->fill = 0;
+	if (dir->users) {
+		dir->stale = 1;
+		return 0;
+	}
+
+	block = dir->block;
+	dir->block = 0;
+	return block;
+}
+
+SceUID dircache_open(const char *path)
+{
+	CachedDir *dir = NULL;
+	SceUID fd = 0;
+	unsigned i;
+	int state;
+
+	if (io_dircache <= 0 || !isAbsolute(path))
+		return 0;
+
+	state = hblLock(globals->ioSema);
+
+	for (i = 0; i < DIRCACHE_MAX; i++)
+		if (dirs[i].block && !dirs[i].fill && !dirs[i].stale
+			&& !strcmp(dirs[i].path, path))
+		{
+			dir = dirs + i;
+			break;
+		}
+
+	if (dir != NULL)
+		for (i = 0; i < DIRCACHE_HANDLES; i++)
+			if (handles[i].dir == NULL) {
+				handles[i].dir = dir;
+				handles[i].pos = 0;
+				handles[i].index = 0;
+				handles[i].kfd = 0;
+				dir->users++;
+				dir->stamp = ++dirClock;
+				fd = DIRCACHE_UID_TAG | i;
+				break;
+			}
+
+	hblUnlock(globals->ioSema, state);
+
+	return fd;
+}
+
+void dircache_fill(SceUID fd, const char *path, unsigned dots)
+{
+	CachedDir *dir = NULL;
+	SceUID block, old = 0;
+	SceSize len;
+	char *buf;
+	unsigned i;
+	int state;
+
+	if (io_dircache <= 0 || fd < 0 || !isAbsolute(path))
+		return;
+
+	len = strlen(path);
+	if (len >= DIRCACHE_PATH_LEN)
+		return;
+
+	block = ledger_alloc(LEDGER_HOMEBREW, "HBL Dir Cache",
+		PSP_SMEM_High, io_dircache, NULL);
+	if (block < 0)
+		return;
+
+	buf = sceKernelGetBlockHeadAddr(block);
+	if (buf == NULL) {
+		ledger_free(block);
+		return;
+	}
+
+	state = hblLock(globals->ioSema);
+
+	// Take an unused entry, or the least recently used idle one
+	for (i = 0; i < DIRCACHE_MAX; i++) {
+		if (!dirs[i].block) {
+			dir = dirs + i;
+			break;
+		}
+
+		if (!dirs[i].fill && !dirs[i].users
+			&& (dir == NULL || dirs[i].stamp < dir->stamp))
+		{
+			dir = dirs + i;
+		}
+	}
+
+	if (dir != NULL) {
+		old = dir->block;
+		dir->block = block;
+		dir->buf = buf;
+		dir->size = io_dircache;
+		dir->len = 0;
+		dir->fill = fd;
+		dir->stale = 0;
+		dir->users = 0;
+		dir->stamp = ++dirClock;
+		dir->dots = dots;
+		memcpy(dir->path, path, len + 1);
+	}
+
+	hblUnlock(globals->ioSema, state);
+
+	if (old)
+		ledger_free(old);
+
+	if (dir == NULL)
+		ledger_free(block);
+}
+
+void dircache_record(SceUID fd, const SceIoDirent *dir, int r)
+{
+	CachedDir *cached = NULL;
+	SceUID block = 0;
+	SceSize len;
+	unsigned i;
+	int state;
+
+	if (io_dircache <= 0)
+		return;
+
+	state = hblLock(globals->ioSema);
+
+	for (i = 0; i < DIRCACHE_MAX; i++)
+		if (dirs[i].block && dirs[i].fill == fd) {
+			cached = dirs + i;
+			break;
+		}
+
+	if (cached != NULL) {
+		if (r == 0)
+			cached->fill = 0;
+		else if (r < 0 || dir->d_private != NULL)
+			// Errors and long names can't be replayed
+			block = dircache_drop(cached);
+		else {
+			len = strlen(dir->d_name) + 1;
+			if (cached->len + sizeof(SceIoStat) + len > cached->size)
+				block = dircache_drop(cached);
+			else {
+				memcpy(cached->buf + cached->len, &dir->d_stat,
+					sizeof(SceIoStat));
+				cached->len += sizeof(SceIoStat);
+				memcpy(cached->buf + cached->len, dir->d_name, len);
+				cached->len += len;
+			}
+		}
+	}
+
+	hblUnlock(globals->ioSema, state);
+
+	if (block)
+		ledger_free(block);
+}
+
+// Opens path from the kernel and skips the entries a handle already read
+static SceUID dircache_reopen(const char *path, unsigned skip)
+{
+	SceIoDirent skipped;
+	SceUID kfd;
+
+	kfd = sceIoDopen(path);
+	if (kfd < 0)
+		return kfd;
+
+	for (; skip > 0; skip--) {
+		memset(&skipped, 0, sizeof(skipped));
+		if (sceIoDread(kfd, &skipped) <= 0)
+			break;
+	}
+
+	return kfd;
+}
+
+int dircache_read(SceUID fd, SceIoDirent *dir)
+{
+	char path[DIRCACHE_PATH_LEN];
+	DirHandle *handle;
+	CachedDir *cached;
+	SceUID kfd;
+	SceSize len;
+	unsigned skip;
+	int state;
+
+	state = hblLock(globals->ioSema);
+
+	handle = dircache_handle(fd);
+	if (handle == NULL) {
+		hblUnlock(globals->ioSema, state);
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+	}
+
+	kfd = handle->kfd;
+	if (kfd) {
+		hblUnlock(globals->ioSema, state);
+		return sceIoDread(kfd, dir);
+	}
+
+	cached = handle->dir;
+
+	// Long names are not recorded, so the kernel has to provide them
+	if (dir->d_private != NULL && handle->index >= cached->dots) {
+		strcpy(path, cached->path);
+		skip = handle->index - cached->dots;
+		hblUnlock(globals->ioSema, state);
+
+		kfd = dircache_reopen(path, skip);
+		if (kfd < 0)
+			return kfd;
+
+		state = hblLock(globals->ioSema);
+		handle->kfd = kfd;
+		hblUnlock(globals->ioSema, state);
+
+		return sceIoDread(kfd, dir);
+	}
+
+	if (handle->pos >= cached->len) {
+		hblUnlock(globals->ioSema, state);
+		return 0;
+	}
+
+	memcpy(&dir->d_stat, cached->buf + handle->pos, sizeof(SceIoStat));
+	handle->pos += sizeof(SceIoStat);
+	len = strlen(cached->buf + handle->pos) + 1;
+	memcpy(dir->d_name, cached->buf + handle->pos, len);
+	handle->pos += len;
+	handle->index++;
+
+	hblUnlock(globals->ioSema, state);
+
+	return 1;
+}
+
+int dircache_close(SceUID fd)
+{
+	DirHandle *handle;
+	CachedDir *dir;
+	SceUID block = 0, kfd = 0;
+	unsigned i;
+	int ret = SCE_KERNEL_ERROR_UNKNOWN_UID;
+	int state;
+
+	state = hblLock(globals->ioSema);
+
+	handle = dircache_handle(fd);
+	if (handle != NULL) {
+		dir = handle->dir;
+		kfd = handle->kfd;
+		handle->dir = NULL;
+		dir->users--;
+		if (dir->stale && !dir->users)
+			block = dircache_drop(dir);
+		ret = 0;
+	} else
+		// A listing closed before its end is incomplete
+		for (i = 0; i < DIRCACHE_MAX; i++)
+			if (dirs[i].block && dirs[i].fill == fd) {
+				block = dircache_drop(dirs + i);
+				break;
+			}
+
+	hblUnlock(globals->ioSema, state);
+
+	if (block)
+		ledger_free(block);
+
+	if (kfd)
+		sceIoDclose(kfd);
+
+	return ret;
+}
+
+void dircache_invalidate(const char *path)
+{
+	SceUID blocks[DIRCACHE_MAX];
+	unsigned i, n = 0;
+	int all, state;
+
+	if (io_dircache <= 0)
+		return;
+
+	all = path == NULL || !isAbsolute(path);
+
+	state = hblLock(globals->ioSema);
+
+	for (i = 0; i < DIRCACHE_MAX; i++)
+		if (dirs[i].block && !dirs[i].stale
+			&& (all || isPrefix(dirs[i].path, path)))
+		{
+			blocks[n] = dircache_drop(dirs + i);
+			if (blocks[n])
+				n++;
+		}
+
+	hblUnlock(globals->ioSema, state);
+
+	while (n > 0) {
+		n--;
+		ledger_free(blocks[n]);
+	}
+}
+
+void dircache_reset()
+{
+	unsigned i;
+
+	for (i = 0; i < DIRCACHE_MAX; i++)
+		dirs[i].block = 0;
+
+	for (i = 0; i < DIRCACHE_HANDLES; i++) {
+		if (handles[i].dir != NULL && handles[i].kfd)
+			sceIoDclose(handles[i].kfd);
+		handles[i].dir = NULL;
+	}
+}
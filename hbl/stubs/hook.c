@@ -2,17 +2,28 @@
 #ifdef NO_SYSCALL_RESOLVER
 #include <common/stubs/tables.h>
 #endif
+#include <common/utils/cache.h>
 #include <common/utils/ctype.h>
 #include <common/utils/string.h>
 #include <common/debug.h>
 #include <common/globals.h>
+#include <common/ledger.h>
 #include <common/memory.h>
 #include <common/path.h>
 #include <common/sdk.h>
+#include <common/trace.h>
+#include <common/uidtable.h>
 #include <common/utils.h>
 #include <hbl/modmgr/modmgr.h>
+#include <hbl/stubs/alloc.h>
+#include <hbl/stubs/bufio.h>
+#include <hbl/stubs/dircache.h>
 #include <hbl/stubs/hook.h>
+#ifdef HOOK_PROFILE
+#include <hbl/stubs/hookprof.h>
+#endif
 #include <hbl/stubs/md5.h>
+#include <hbl/stubs/pool.h>
 #include <hbl/stubs/resolve.h>
 #include <hbl/eloader.h>
 #include <hbl/settings.h>
@@ -25,7 +36,12 @@
 // Hooks for some functions used by Homebrews
 // Hooks are put in place by resolve_imports() calling setup_hook()
 
-#define SIZE_THREAD_TRACKING_ARRAY 32
+// Threads tracked at once is 3/4 of THREAD_TABLE_SIZE
+#define THREAD_TABLE_BITS 7
+#define THREAD_TABLE_SIZE (1 << THREAD_TABLE_BITS)
+// Files tracked at once is 3/4 of FILE_TABLE_SIZE
+#define FILE_TABLE_BITS 6
+#define FILE_TABLE_SIZE (1 << FILE_TABLE_BITS)
 #define MAX_CALLBACKS 32
 
 static int dirLen;
@@ -37,13 +53,51 @@ static char mod_chdir[263] = HBL_ROOT;
 
 static int cur_cpufreq = 0; //current cpu frequency
 static int cur_busfreq = 0; //current bus frequency
-static SceUID running_th[SIZE_THREAD_TRACKING_ARRAY];
-static SceUID pending_th[SIZE_THREAD_TRACKING_ARRAY];
-static SceUID exited_th[SIZE_THREAD_TRACKING_ARRAY];
-static SceUID openFiles[16];
-static unsigned numOpenFiles = 0;
-static SceUID osAllocs[512];
-static unsigned osAllocNum = 0;
+
+typedef enum {
+	TH_UNTRACKED = 0,
+	TH_PENDING,	// Created but not started
+	TH_RUNNING,
+	TH_EXITED	// Exited but not deleted (DELETE_EXIT_THREADS)
+} ThreadState;
+
+typedef struct {
+	SceUID thid;
+	ThreadState state;
+} ThreadEntry;
+
+#ifdef IO_PROFILE
+// Number of distinct paths profiled
+#define IO_PROFILE_MAX 64
+// Characters of the path kept for the report, including the terminator
+#define IO_PROFILE_NAME_LEN 40
+
+typedef struct {
+	char name[IO_PROFILE_NAME_LEN];
+	unsigned opens;
+	unsigned reads;
+	unsigned writes;
+	unsigned seeks;
+	u32 bytesRead;
+	u32 bytesWritten;
+	u32 time;	// Microseconds spent in the kernel calls
+} IoProfile;
+
+static IoProfile ioProfiles[IO_PROFILE_MAX];
+static unsigned numIoProfiles = 0;
+#endif
+
+typedef struct {
+	SceUID fd;
+#ifdef IO_PROFILE
+	IoProfile *prof;
+#endif
+} FileEntry;
+
+static ThreadEntry threads[THREAD_TABLE_SIZE];
+static UidTable threadTable = { threads, sizeof(ThreadEntry), THREAD_TABLE_BITS, 0 };
+static FileEntry openFiles[FILE_TABLE_SIZE];
+static UidTable fileTable = { openFiles, sizeof(FileEntry), FILE_TABLE_BITS, 0 };
 static SceKernelCallbackFunction cbfuncs[MAX_CALLBACKS];
 static int cbids[MAX_CALLBACKS];
 static int cbcount = 0;
@@ -53,8 +107,6 @@ static int cur_ch_id = -1;
 static void *frame_topaddr[2] = { NULL, NULL };
 static int frame_bufferwidth[2], frame_pixelformat[2];
 
-static unsigned int rdm_seed;
-
 void (* net_term_func[5])();
 int net_term_num = 0;
 
@@ -74,24 +126,161 @@ int _hook_sceAudioChRelease(int channel);
 int _hook_sceAudioSRCChRelease();
 SceUID sceIoDopen_Vita(const char *dirname);
 
-static int hblWaitSema(SceUID semaid, int signal, SceUInt *timeout)
+static void wake_exit(u32 bits)
 {
-	if (isImported(sceKernelWaitSema))
-		return sceKernelWaitSema(semaid, signal, timeout);
-	else if (isImported(sceKernelWaitSemaCB))
-		return sceKernelWaitSemaCB(semaid, signal, timeout);
-	else
-		return SCE_KERNEL_ERROR_ERROR;
+	if (exit_evf >= 0)
+		sceKernelSetEventFlag(exit_evf, bits);
+}
+
+// Wakes wait_for_eboot_end if the force-exit combo is held in the latest
+// of num samples
+static void check_exit_buttons(const SceCtrlData *data, int num)
+{
+	if (num > 0 && force_exit_buttons
+		&& data[num - 1].Buttons == force_exit_buttons)
+	{
+		wake_exit(EXIT_EVF_BUTTONS);
+	}
+}
+
+// Reads count samples with whatever HBL imports
+static int read_pad(SceCtrlData *dst, int count)
+{
+	int r;
+
+	if (isImported(sceCtrlReadBufferPositive))
+		r = sceCtrlReadBufferPositive(dst, count);
+	else if (isImported(sceCtrlPeekBufferPositive))
+		r = sceCtrlPeekBufferPositive(dst, count);
+	else {
+		memset(dst, 0, count * sizeof(SceCtrlData));
+		r = count;
+	}
+
+	check_exit_buttons(dst, r);
+
+	return r;
 }
 
+int sample_pad(SceCtrlData *dst)
+{
+	return read_pad(dst, 1) > 0 && force_exit_buttons
+		&& dst->Buttons == force_exit_buttons;
+}
+
+// Read into the caller's buffer at its own pace. pad belongs to the HBL
+// thread.
 static int _hook_sceCtrlReadBufferPositive(SceCtrlData *dst, int count)
 {
 	if (dst == NULL)
 		return SCE_KERNEL_ERROR_ILLEGAL_ADDRESS;
 
-	memcpy(dst, &pad, sizeof(SceCtrlData));
-	return 1;
+	if (count <= 0)
+		return 0;
+
+	return read_pad(dst, count);
+}
+
+#ifdef NO_SYSCALL_RESOLVER
+// Peeking must not block, so if HBL can't peek itself, the last sample of
+// the HBL thread stands in
+static int _hook_sceCtrlPeekBufferPositive(SceCtrlData *dst, int count)
+{
+	int i, r;
+
+	if (dst == NULL)
+		return SCE_KERNEL_ERROR_ILLEGAL_ADDRESS;
+
+	if (count <= 0)
+		return 0;
+
+	if (!isImported(sceCtrlPeekBufferPositive)) {
+		for (i = 0; i < count; i++)
+			dst[i] = pad;
+
+		return count;
+	}
+
+	r = sceCtrlPeekBufferPositive(dst, count);
+	check_exit_buttons(dst, r);
+
+	return r;
+}
+#endif
+
+static int *thCount(ThreadState state)
+{
+	switch (state) {
+		case TH_PENDING:
+			return &num_pend_th;
+		case TH_RUNNING:
+			return &num_run_th;
+		case TH_EXITED:
+			return &num_exit_th;
+		default:
+			return NULL;
+	}
+}
+
+static ThreadState thGet(SceUID thid)
+{
+	ThreadEntry *entry;
+
+	entry = uidtable_find(&threadTable, thid);
+
+	return entry == NULL ? TH_UNTRACKED : entry->state;
+}
+
+/*
+ * Moves a thread to another state, TH_UNTRACKED removing it.
+ * Returns SCE_KERNEL_ERROR_NO_MEMORY if the table is full.
+ * Must be called with thSema locked.
+ */
+static int thSet(SceUID thid, ThreadState state)
+{
+	ThreadEntry *entry;
+
+	if (state == TH_UNTRACKED) {
+		entry = uidtable_find(&threadTable, thid);
+		if (entry != NULL) {
+			(*thCount(entry->state))--;
+			uidtable_remove(&threadTable, thid);
+		}
+
+		return 0;
+	}
+
+	entry = uidtable_add(&threadTable, thid);
+	if (entry == NULL)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+
+	if (entry->state != TH_UNTRACKED)
+		(*thCount(entry->state))--;
+
+	entry->state = state;
+	(*thCount(state))++;
+
+	return 0;
+}
+
+#ifdef MONITOR_AUDIO_THREADS
+// Releases the audio channels the exiting thread left reserved (Ditlew)
+static void releaseThreadAudio(SceUID thid)
+{
+	int i, state;
+	int channels = 0;
+
+	state = hblLock(globals->audioSema);
+	for (i = 0; i < 8; i++)
+		if (audio_th[i] == thid)
+			channels |= 1 << i;
+	hblUnlock(globals->audioSema, state);
+
+	for (i = 0; channels; i++, channels >>= 1)
+		if (channels & 1)
+			_hook_sceAudioChRelease(i);
 }
+#endif
 
 // Thread hooks original code thanks to Noobz & Fanjita, adapted by wololo
 /*****************************************************************************/
@@ -104,57 +293,37 @@ static int _hook_sceCtrlReadBufferPositive(SceCtrlData *dst, int count)
 /*****************************************************************************/
 int _hook_sceKernelExitThread(int status)
 {
-	int i;
-	int found = 0;
 	int thid = sceKernelGetThreadId();
+	int last, r, state;
 
 	dbg_printf("Enter hookExitThread : %08X\n", thid);
 
-	hblWaitSema(globals->thSema, 1, 0);
-
-	for (i = 0; i < num_run_th; i++) {
-		if (running_th[i] == thid) {
-			found = 1;
-			num_run_th--;
-			dbg_printf("Running threads: %d\n", num_run_th);
-		}
-
-		if (found && i <= SIZE_THREAD_TRACKING_ARRAY - 2)
-			running_th[i] = running_th[i + 1];
-	}
-
-	running_th[num_run_th] = 0;
-
-
+	state = hblLock(globals->thSema);
 #ifdef DELETE_EXIT_THREADS
-	dbg_printf("Num exit thr: %08X\n", num_exit_th);
-
 	/*************************************************************************/
-	/* Add to exited list                                                    */
+	/* Move to exited list                                                   */
 	/*************************************************************************/
-	if (num_exit_th < SIZE_THREAD_TRACKING_ARRAY)
-	{
-		dbg_printf("Set array\n");
-		exited_th[num_exit_th] = thid;
-		num_exit_th++;
-
-		dbg_printf("Exited threads: %d\n", num_exit_th);
-	}
+	r = thSet(thid, TH_EXITED);
+#else
+	r = thSet(thid, TH_UNTRACKED);
 #endif
+	last = num_run_th <= 0;
+	hblUnlock(globals->thSema, state);
+
+	trace_event(TRACE_THREAD_EXIT, thid, status, 0);
+
+	if (last)
+		wake_exit(EXIT_EVF_THREADS);
+
+	if (r)
+		dbg_printf("!!! Too many threads, 0x%08X not tracked\n", thid);
+	dbg_printf("Running threads: %d\n", num_run_th);
+	dbg_printf("Exited threads: %d\n", num_exit_th);
 
 #ifdef MONITOR_AUDIO_THREADS
-	// Ditlew
-	for (i = 0; i < 8; i++)
-	{
-		hblWaitSema(globals->audioSema, 1, 0);
-		if (audio_th[i] == thid)
-			_hook_sceAudioChRelease(i);
-		sceKernelSignalSema(globals->audioSema, 1);
-	}
+	releaseThreadAudio(thid);
 #endif
 
-	sceKernelSignalSema(globals->thSema, 1);
-
 	dbg_printf("Exit hookExitThread\n");
 
 	return sceKernelExitThread(status);
@@ -170,63 +339,35 @@ int _hook_sceKernelExitThread(int status)
 /*****************************************************************************/
 int _hook_sceKernelExitDeleteThread(int status)
 {
-	int i;
-	int found = 0;
 	int thid = sceKernelGetThreadId();
+	int last, state;
 
 	
 	dbg_printf("Enter hookExitDeleteThread : %08X\n", thid);
 
-	hblWaitSema(globals->thSema, 1, 0);
-
-	for (i = 0; i < num_run_th; i++) {
-		if (running_th[i] == thid) {
-			found = 1;
-			num_run_th--;
-			dbg_printf("Running threads: %d\n", num_run_th);
-		}
-
-		if (found && i <= SIZE_THREAD_TRACKING_ARRAY - 2)
-			running_th[i] = running_th[i + 1];
-	}
+	// The thread deletes itself, so it is not kept as exited
+	state = hblLock(globals->thSema);
+	thSet(thid, TH_UNTRACKED);
+	last = num_run_th <= 0;
+	hblUnlock(globals->thSema, state);
 
-	running_th[num_run_th] = 0;
+	trace_event(TRACE_THREAD_EXIT, thid, status, 0);
 
+	if (last)
+		wake_exit(EXIT_EVF_THREADS);
 
+	dbg_printf("Running threads: %d\n", num_run_th);
 
 	dbg_printf("Exit hookExitDeleteThread\n");
 
 #ifdef MONITOR_AUDIO_THREADS
-	// Ditlew
-	for (i = 0; i < 8; i++) {
-		hblWaitSema(globals->audioSema, 1, 0);
-		if (audio_th[i] == thid)
-			_hook_sceAudioChRelease(i);
-		sceKernelSignalSema(globals->audioSema, 1);
-	}
+	releaseThreadAudio(thid);
 #endif
 
 	//return (sceKernelExitDeleteThread(status));
 	// (Patapon does not import this function)
 	// But modules on p5 do.
 
-#ifdef DELETE_EXIT_THREADS
-	dbg_printf("Num exit thr: %08X\n", num_exit_th);
-
-	/*************************************************************************/
-	/* Add to exited list                                                    */
-	/*************************************************************************/
-	if (num_exit_th < SIZE_THREAD_TRACKING_ARRAY)
-	{
-		dbg_printf("Set array\n");
-		exited_th[num_exit_th] = thid;
-		num_exit_th++;
-
-		dbg_printf("Exited threads: %d\n", num_exit_th);
-	}
-#endif
-
-	sceKernelSignalSema(globals->thSema, 1);
 	return sceKernelExitDeleteThread(status);
 }
 
@@ -244,6 +385,7 @@ SceUID _hook_sceKernelCreateThread(const char *name, void *entry,
 
 
 	SceUID lreturn = sceKernelCreateThread(name, entry, initPriority, stackSize, attr, option);
+	int r, state;
 
 	if (lreturn < 0)
 	{
@@ -256,17 +398,16 @@ SceUID _hook_sceKernelCreateThread(const char *name, void *entry,
 	/*************************************************************************/
 	/* Add to pending list                                                   */
 	/*************************************************************************/
-	hblWaitSema(globals->thSema, 1, 0);
-	if (num_pend_th < SIZE_THREAD_TRACKING_ARRAY)
-	{
-		dbg_printf("Set array\n");
-		pending_th[num_pend_th] = lreturn;
-		num_pend_th++;
+	state = hblLock(globals->thSema);
+	r = thSet(lreturn, TH_PENDING);
+	hblUnlock(globals->thSema, state);
 
-		dbg_printf("Pending threads: %d\n",	num_pend_th);
-	}
+	trace_event(TRACE_THREAD_CREATE, lreturn, (u32)entry, initPriority);
+
+	if (r)
+		dbg_printf("!!! Too many threads, 0x%08X not tracked\n", lreturn);
+	dbg_printf("Pending threads: %d\n",	num_pend_th);
 
-	sceKernelSignalSema(globals->thSema, 1);
 	return(lreturn);
 
 }
@@ -274,49 +415,24 @@ SceUID _hook_sceKernelCreateThread(const char *name, void *entry,
 /*****************************************************************************/
 /* Special startThread handling:                                             */
 /*                                                                           */
-/*   Remove the thread from the list of pending threads.                     */
-/*   Add the thread to the list of tracked threads, then pass on the call.   */
+/*   Move the thread from the list of pending threads to the list of         */
+/*   running threads, then pass on the call.                                 */
 /*****************************************************************************/
 int _hook_sceKernelStartThread(SceUID thid, SceSize arglen, void *argp)
 {
-	int i;
-	int found = 0;
+	int state;
 
 	dbg_printf("Enter hookRunThread: %08X\n", thid);
 
-	hblWaitSema(globals->thSema, 1, 0);
-
-	dbg_printf("Number of pending threads: %08X\n", num_pend_th);
-
-	/***************************************************************************/
-	/* Remove from pending list                                                */
-	/***************************************************************************/
-	for (i = 0; i < num_pend_th; i++) {
-		if (pending_th[i] == thid) {
-			found = 1;
-			num_pend_th--;
-			dbg_printf("Pending threads: %d\n", num_pend_th);
-		}
-
-		if (found && i <= SIZE_THREAD_TRACKING_ARRAY - 2)
-			pending_th[i] = pending_th[i + 1];
-	}
+	state = hblLock(globals->thSema);
+	if (thGet(thid) == TH_PENDING)
+		thSet(thid, TH_RUNNING);
+	hblUnlock(globals->thSema, state);
 
-	if (found) {
-		pending_th[num_pend_th] = 0;
-
-		/***************************************************************************/
-		/* Add to running list                                                     */
-		/***************************************************************************/
-		dbg_printf("Number of running threads: %08X\n", num_run_th);
-		if (num_run_th < SIZE_THREAD_TRACKING_ARRAY) {
-			running_th[num_run_th] = thid;
-			num_run_th++;
-			dbg_printf("Running threads: %d\n", num_run_th);
-		}
-	}
+	trace_event(TRACE_THREAD_START, thid, 0, 0);
 
-	sceKernelSignalSema(globals->thSema, 1);
+	dbg_printf("Pending threads: %d\n", num_pend_th);
+	dbg_printf("Running threads: %d\n", num_run_th);
 
 
 	dbg_printf("Exit hookRunThread: %08X\n", thid);
@@ -331,8 +447,10 @@ int _hook_sceKernelStartThread(SceUID thid, SceSize arglen, void *argp)
 void threads_cleanup()
 {
 	u32 i;
+	static ThreadEntry doomed[THREAD_TABLE_SIZE];
+	int state;
+
 	dbg_printf("Threads cleanup\n");
-	hblWaitSema(globals->thSema, 1, 0);
 #ifdef MONITOR_AUDIO_THREADS
 	// Ditlew
 	 dbg_printf("cleaning audio threads\n");
@@ -344,37 +462,40 @@ void threads_cleanup()
 	}
 #endif
 
-	dbg_printf("%d running threads remain\n", num_run_th);
-	while (num_run_th > 0)
-	{
-		dbg_printf("Kill thread ID %08X\n", running_th[num_run_th - 1]);
-		kill_thread(running_th[num_run_th - 1]);
-		num_run_th--;
-	}
+	dbg_printf("%d running, %d pending and %d exited threads remain\n",
+		num_run_th, num_pend_th, num_exit_th);
+
+	// Threads can't be killed with interrupts masked, so empty the
+	// table first and work on the copy
+	state = hblLock(globals->thSema);
+	memcpy(doomed, threads, sizeof(threads));
+	uidtable_clear(&threadTable);
+	num_run_th = 0;
+	num_pend_th = 0;
+	num_exit_th = 0;
+	hblUnlock(globals->thSema, state);
+
+	for (i = 0; i < THREAD_TABLE_SIZE; i++) {
+		switch (doomed[i].state) {
+			case TH_RUNNING:
+				dbg_printf("Kill thread ID %08X\n", doomed[i].thid);
+				kill_thread(doomed[i].thid);
+				break;
 
+			case TH_PENDING:
+			case TH_EXITED:
+				/***********************************************************/
+				/* Delete the threads that haven't been deleted yet        */
+				/***********************************************************/
+				dbg_printf("Delete thread ID %08X\n", doomed[i].thid);
+				sceKernelDeleteThread(doomed[i].thid);
+				break;
 
-	dbg_printf("%d pending threads remain\n", num_pend_th);
-	while (num_pend_th > 0)
-	{
-		dbg_printf("Kill thread ID %08X\n", pending_th[num_pend_th - 1]);
-		sceKernelDeleteThread(pending_th[num_pend_th - 1]);
-		num_pend_th--;
+			default:
+				break;
+		}
 	}
 
-#ifdef DELETE_EXIT_THREADS
-	/***************************************************************************/
-	/* Delete the threads that exitted but haven't been deleted yet            */
-	/***************************************************************************/
-	dbg_printf("%d exited threads remain\n", num_exit_th);
-	 while (num_exit_th > 0)
-	 {
-		dbg_printf("Delete thread ID %08X\n", exited_th[num_exit_th - 1]);
-		sceKernelDeleteThread(exited_th[num_exit_th - 1]);
-		num_exit_th--;
-	 }
-#endif
-
-	sceKernelSignalSema(globals->thSema, 1);
 	dbg_printf("Threads cleanup Done\n");
 }
 
@@ -466,21 +587,65 @@ static int writenpath(char * restrict dst, const char * restrict src,
 	return r;
 }
 
+// realnpath only changes paths where a '/' is followed by '/' or '.'
+static int isNormalized(const char *p)
+{
+	if (p[0] == '/' || p[0] == '.')
+		return 0;
+
+	for (; *p; p++)
+		if (p[0] == '/' && (p[1] == '/' || p[1] == '.'))
+			return 0;
+
+	return 1;
+}
+
+// realnpath or writenpath, copying paths they would leave unchanged
+static int resolvepath(char * restrict dst, const char * restrict src,
+	size_t n, int write)
+{
+	size_t len;
+
+	if (dst == NULL || src == NULL)
+		return SCE_KERNEL_ERROR_ILLEGAL_ADDR;
+
+	// writenpath also rewrites EBOOT.PBP paths on emulators
+	if ((!write || !globals->isEmu) && isNormalized(src)) {
+		len = strlen(src);
+		if (len >= n)
+			return SCE_KERNEL_ERROR_NAMETOOLONG;
+
+		memcpy(dst, src, len + 1);
+		return len;
+	}
+
+	return write ? writenpath(dst, src, n) : realnpath(dst, src, n);
+}
+
 //hook this ONLY if test_sceIoChdir() fails!
 SceUID _hook_sceIoDopen(const char *dirname)
 {
 	SceUID uid;
 	char *resolved;
+	unsigned dots = 0;
 	int n;
 
 	if (dirname == NULL)
 		return SCE_KERNEL_ERROR_ILLEGAL_ADDR;
 
-	n = realpathMax(dirname);
-	resolved = __builtin_alloca(n);
-	n = realnpath(resolved, dirname, n);
-	if (n < 0)
-		return n;
+	// Also hooked for the listing cache when the kernel handles chdir
+	if (globals->isEmu || !globals->chdir_ok) {
+		n = realpathMax(dirname);
+		resolved = __builtin_alloca(n);
+		n = resolvepath(resolved, dirname, n, 0);
+		if (n < 0)
+			return n;
+	} else
+		resolved = (char *)dirname;
+
+	uid = dircache_open(resolved);
+	if (uid)
+		return uid;
 
 	uid = sceIoDopen(resolved);
 	if (uid >= 0 && globals->isEmu
@@ -491,12 +656,15 @@ SceUID _hook_sceIoDopen(const char *dirname)
 		if (n < MAX_OPEN_DIR_VITA) {
 			globals->dirFix[n][0] = uid;
 			globals->dirFix[n][1] = 2;
+			dots = 2;
 
 			if (n == dirLen)
 				dirLen++;
 		}
 	}
 
+	dircache_fill(uid, resolved, dots);
+
 	return uid;
 }
 
@@ -559,6 +727,29 @@ int sceIoDclose_Vita(SceUID id)
 	return sceIoDclose(id);
 }
 
+// sceIoDread and sceIoDclose, going through the listing cache
+static int _hook_sceIoDread(SceUID id, SceIoDirent *dir)
+{
+	int r;
+
+	r = dircache_read(id, dir);
+	if (r != SCE_KERNEL_ERROR_UNKNOWN_UID)
+		return r;
+
+	r = globals->isEmu ? sceIoDread_Vita(id, dir) : sceIoDread(id, dir);
+	dircache_record(id, dir, r);
+
+	return r;
+}
+
+static int _hook_sceIoDclose(SceUID id)
+{
+	if (!dircache_close(id))
+		return 0;
+
+	return globals->isEmu ? sceIoDclose_Vita(id) : sceIoDclose(id);
+}
+
 static int _hook_sceIoMkdir(const char *dir, SceMode mode)
 {
 	char *resolved;
@@ -567,12 +758,20 @@ static int _hook_sceIoMkdir(const char *dir, SceMode mode)
 	if (dir == NULL)
 		return SCE_KERNEL_ERROR_ILLEGAL_ADDR;
 
+	// Also hooked for the listing cache when the kernel handles chdir
+	if (!globals->isEmu && globals->chdir_ok) {
+		dircache_invalidate(dir);
+		return sceIoMkdir(dir, mode);
+	}
+
 	r = realpathMax(dir);
 	resolved = __builtin_alloca(r);
-	r = realnpath(resolved, dir, r);
+	r = resolvepath(resolved, dir, r, 0);
 	if (r < 0)
 		return r;
 
+	dircache_invalidate(resolved);
+
 	if (globals->isEmu && !strcasecmp("ms0:/PSP/GAME", resolved)) {
 		resolved[5] = 'Q';
 
@@ -598,18 +797,27 @@ static int _hook_sceIoRename(const char *old, const char *new)
 	if (old == NULL || new == NULL)
 		return SCE_KERNEL_ERROR_ILLEGAL_ADDR;
 
+	if (!globals->isEmu && globals->chdir_ok) {
+		dircache_invalidate(old);
+		dircache_invalidate(new);
+		return sceIoRename(old, new);
+	}
+
 	n = writepathMax(old);
 	oldResolved = __builtin_alloca(n);
-	n = writenpath(oldResolved, old, n);
+	n = resolvepath(oldResolved, old, n, 1);
 	if (n < 0)
 		return n;
 
 	n = writepathMax(new);
 	newResolved = __builtin_alloca(n);
-	n = writenpath(newResolved, new, n);
+	n = resolvepath(newResolved, new, n, 1);
 	if (n < 0)
 		return n;
 
+	dircache_invalidate(oldResolved);
+	dircache_invalidate(newResolved);
+
 	if (!strcasecmp("ms0:/PSP/GAME", oldResolved)) {
 		oldResolved[5] = 'Q';
 		qsp = sceIoRename("ms0:/PSP.", "ms0:/QSP");
@@ -631,12 +839,19 @@ static int _hook_sceIoRemove(const char *file)
 	if (file == NULL)
 		return SCE_KERNEL_ERROR_ILLEGAL_ADDR;
 
+	if (!globals->isEmu && globals->chdir_ok) {
+		dircache_invalidate(file);
+		return sceIoRemove(file);
+	}
+
 	n = writepathMax(file);
 	resolved = __builtin_alloca(n);
-	r = writenpath(resolved, file, n);
+	r = resolvepath(resolved, file, n, 1);
 	if (r < 0)
 		return r;
 
+	dircache_invalidate(resolved);
+
 	if (!strcasecmp("ms0:/PSP/GAME", resolved)) {
 		resolved[5] = 'Q';
 		qsp = sceIoRename("ms0:/PSP.", "ms0:/QSP");
@@ -650,6 +865,16 @@ static int _hook_sceIoRemove(const char *file)
 	}
 }
 
+static int _hook_sceIoRmdir(const char *dir)
+{
+	if (dir == NULL)
+		return SCE_KERNEL_ERROR_ILLEGAL_ADDR;
+
+	dircache_invalidate(dir);
+
+	return sceIoRmdir(dir);
+}
+
 
 //hook this ONLY if test_sceIoChdir() fails!
 int _hook_sceIoChdir(const char *dirname)
@@ -678,11 +903,117 @@ int _hook_sceIoChdir(const char *dirname)
 	return 0;
 }
 
+#ifdef IO_PROFILE
+u32 io_profile_clock()
+{
+	return isImported(sceKernelGetSystemTimeLow) ? sceKernelGetSystemTimeLow() : 0;
+}
+
+// Returns the record of a path, creating it if needed.
+// Must be called with ioSema locked.
+static IoProfile *ioProfileGet(const char *path)
+{
+	IoProfile *prof;
+	size_t len;
+	unsigned i;
+
+	// The end of long paths is what tells the files apart
+	len = strlen(path);
+	if (len >= IO_PROFILE_NAME_LEN)
+		path += len - (IO_PROFILE_NAME_LEN - 1);
+
+	for (i = 0; i < numIoProfiles; i++)
+		if (!strcmp(ioProfiles[i].name, path))
+			return ioProfiles + i;
+
+	if (numIoProfiles >= IO_PROFILE_MAX)
+		return NULL;
+
+	prof = ioProfiles + numIoProfiles;
+	numIoProfiles++;
+	memset(prof, 0, sizeof(IoProfile));
+	strcpy(prof->name, path);
+
+	return prof;
+}
+
+void io_profile_add(SceUID fd, IoProfileOp op, int result, u32 start)
+{
+	FileEntry *entry;
+	IoProfile *prof;
+	u32 time;
+	int state;
+
+	time = io_profile_clock() - start;
+
+	state = hblLock(globals->ioSema);
+
+	entry = uidtable_find(&fileTable, fd);
+	prof = entry == NULL ? NULL : entry->prof;
+	if (prof != NULL) {
+		prof->time += time;
+		switch (op) {
+			case IO_PROFILE_READ:
+				prof->reads++;
+				if (result > 0)
+					prof->bytesRead += result;
+				break;
+
+			case IO_PROFILE_WRITE:
+				prof->writes++;
+				if (result > 0)
+					prof->bytesWritten += result;
+				break;
+
+			case IO_PROFILE_SEEK:
+				prof->seeks++;
+				break;
+		}
+	}
+
+	hblUnlock(globals->ioSema, state);
+}
+
+// Prints the records from the most to the least time spent, then
+// forgets them
+static void ioProfileReport()
+{
+	static IoProfile report[IO_PROFILE_MAX];
+	IoProfile tmp;
+	unsigned i, j, num;
+	int state;
+
+	state = hblLock(globals->ioSema);
+	num = numIoProfiles;
+	memcpy(report, ioProfiles, num * sizeof(IoProfile));
+	numIoProfiles = 0;
+	hblUnlock(globals->ioSema, state);
+
+	for (i = 1; i < num; i++) {
+		tmp = report[i];
+		for (j = i; j > 0 && report[j - 1].time < tmp.time; j--)
+			report[j] = report[j - 1];
+		report[j] = tmp;
+	}
+
+	dbg_printf("I/O profile: opens reads writes seeks bytes read/written time (us) path\n");
+	for (i = 0; i < num; i++)
+		dbg_printf("%d %d %d %d %d/%d %d %s\n",
+			report[i].opens, report[i].reads, report[i].writes,
+			report[i].seeks, report[i].bytesRead,
+			report[i].bytesWritten, report[i].time, report[i].name);
+}
+#endif
+
 static SceUID _hook_sceIoOpen(const char *file, int flags, SceMode mode)
 {
+	FileEntry *entry;
 	SceUID r;
-	unsigned i;
+	int state;
 	char *resolved;
+#ifdef IO_PROFILE
+	u32 start = io_profile_clock();
+#endif
 
 	if (file == NULL)
 		return SCE_KERNEL_ERROR_ILLEGAL_ADDR;
@@ -691,11 +1022,11 @@ static SceUID _hook_sceIoOpen(const char *file, int flags, SceMode mode)
 		if (flags & PSP_O_WRONLY) {
 			r = writepathMax(file);
 			resolved = __builtin_alloca(r);
-			r = writenpath(resolved, file, r);
+			r = resolvepath(resolved, file, r, 1);
 		} else {
 			r = realpathMax(file);
 			resolved = __builtin_alloca(r);
-			r = realnpath(resolved, file, r);
+			r = resolvepath(resolved, file, r, 0);
 		}
 
 		if (r < 0)
@@ -704,22 +1035,31 @@ static SceUID _hook_sceIoOpen(const char *file, int flags, SceMode mode)
 		file = resolved;
 	}
 
+	if (flags & PSP_O_WRONLY)
+		dircache_invalidate(file);
+
 	r = sceIoOpen(file, flags, mode);
 
 	if (r >= 0) {
-		hblWaitSema(globals->ioSema, 1, 0);
-
-		if (numOpenFiles < sizeof(openFiles) / sizeof(SceUID) - 1)
-			for (i = 0; i < sizeof(openFiles) / sizeof(SceUID); i++)
-				if (openFiles[i] == 0) {
-					openFiles[i] = r;
-					numOpenFiles++;
-					break;
-				}
-		else
+		state = hblLock(globals->ioSema);
+
+		entry = uidtable_add(&fileTable, r);
+#ifdef IO_PROFILE
+		if (entry != NULL) {
+			entry->prof = ioProfileGet(file);
+			if (entry->prof != NULL) {
+				entry->prof->opens++;
+				entry->prof->time += io_profile_clock() - start;
+			}
+		}
+#endif
+
+		hblUnlock(globals->ioSema, state);
+
+		if (entry == NULL)
 			dbg_printf("WARNING: file list full, cannot add newly opened file\n");
 
-		sceKernelSignalSema(globals->ioSema, 1);
+		bufio_open(r, file, flags);
 	}
 
 	return r;
@@ -729,22 +1069,21 @@ static SceUID _hook_sceIoOpen(const char *file, int flags, SceMode mode)
 static int _hook_sceIoClose(SceUID fd)
 {
 	SceUID ret;
-	unsigned i;
+	int flushed, state;
 	
+	// Pending writes must reach the file before it is closed, and the
+	// buffer must be gone before the descriptor can be reused
+	flushed = bufio_detach(fd);
+
 	ret = sceIoClose(fd);
 
 	if (!ret) {
-		hblWaitSema(globals->ioSema, 1, 0);
+		if (flushed < 0)
+			ret = flushed;
 
-		for (i = 0; i < sizeof(openFiles) / sizeof(SceUID); i++) {
-			if (openFiles[i] == fd) {
-				openFiles[i] = 0;
-				numOpenFiles--;
-				break;
-			}
-		}
-
-		sceKernelSignalSema(globals->ioSema, 1);
+		state = hblLock(globals->ioSema);
+		uidtable_remove(&fileTable, fd);
+		hblUnlock(globals->ioSema, state);
 	}
 
 	return ret;
@@ -754,23 +1093,34 @@ static int _hook_sceIoClose(SceUID fd)
 // Close all files that remained open after the homebrew quits
 void files_cleanup()
 {
+	static FileEntry doomed[FILE_TABLE_SIZE];
 	unsigned i;
+	int state;
 
 	dbg_printf("Files Cleanup\n");
 	
-	hblWaitSema(globals->ioSema, 1, 0);
-	for (i = 0; i < sizeof(openFiles) / sizeof(SceUID); i++)
-	{
-		if (openFiles[i] != 0)
+	bufio_flush_all();
+	bufio_reset();
+	dircache_reset();
+
+	// Files can't be closed with interrupts masked, so empty the
+	// table first and work on the copy
+	state = hblLock(globals->ioSema);
+	memcpy(doomed, openFiles, sizeof(openFiles));
+	uidtable_clear(&fileTable);
+	hblUnlock(globals->ioSema, state);
+
+	for (i = 0; i < FILE_TABLE_SIZE; i++)
+		if (doomed[i].fd != 0)
 		{
-			sceIoClose(openFiles[i]);
-			dbg_printf("closing file UID 0x%08X\n", openFiles[i]);
-			openFiles[i] = 0;
+			sceIoClose(doomed[i].fd);
+			dbg_printf("closing file UID 0x%08X\n", doomed[i].fd);
 		}
-	}
 
-	numOpenFiles = 0;
-	sceKernelSignalSema(globals->ioSema, 1);
+#ifdef IO_PROFILE
+	ioProfileReport();
+#endif
+
 	dbg_printf("Files Cleanup Done\n");
 }
 
@@ -797,19 +1147,17 @@ static void audio_term()
 #endif
 }
 
-void ram_cleanup()
+// Frees the blocks left by the homebrew and reports the ones leaked by HBL
+int ram_cleanup()
 {
-	unsigned i;
+	int leaks;
 
 	dbg_printf("Ram Cleanup\n");
-
-	hblWaitSema(globals->memSema, 1, 0);
-	for (i = 0; i < osAllocNum; i++)
-		sceKernelFreePartitionMemory(osAllocs[i]);
-	osAllocNum = 0;
-	sceKernelSignalSema(globals->memSema, 1);
-
+	leaks = ledger_cleanup();
+	pool_reset();
 	dbg_printf("Ram Cleanup Done\n");
+
+	return leaks;
 }
 
 
@@ -819,8 +1167,8 @@ void exit_everything()
 	audio_term();
 	subinterrupthandler_cleanup();
 	threads_cleanup();
-	ram_cleanup();
 	files_cleanup();
+	ram_cleanup();
 }
 
 void _hook_sceKernelExitGame()
@@ -831,6 +1179,7 @@ void _hook_sceKernelExitGame()
 		hblExitGameWithStatus(0);
 
 	_hook_sceKernelExitGame_IsCalled = 1;
+	wake_exit(EXIT_EVF_GAME);
 
 	if (isImported(sceKernelExitDeleteThread))
 		_hook_sceKernelExitDeleteThread(0);
@@ -840,85 +1189,61 @@ void _hook_sceKernelExitGame()
 
 SceUID _hook_sceKernelAllocPartitionMemory(SceUID partitionid, const char *name, int type, SceSize size, void *addr)
 {
+	SceUID uid;
+	SceSize original_size = size;
+	SceSize min;
+
 	dbg_printf("call to sceKernelAllocPartitionMemory partitionId: %d, name: %s, type:%d, size:%d, addr:0x%08X\n", partitionid, (u32)name, type, size, (u32)addr);
-	hblWaitSema(globals->memSema, 1, 0);
+
+	// Small objects share slabs instead of getting a block each
+	if (partitionid == 2 && size <= alloc_pool_threshold
+		&& (type == PSP_SMEM_Low || type == PSP_SMEM_High)) {
+		uid = pool_alloc(size);
+		if (uid >= 0)
+			return uid;
+	}
 
 	// Try to allocate the requested memory. If the allocation fails due to an insufficient
-	// amount of free memory try again with 10kB less until the allocation succeeds.
-	// Don't allow to go under 80 % of the initial amount of memory.
-	SceUID uid;
-	SceSize original_size = size;
-	do
-	{
-		uid = sceKernelAllocPartitionMemory(partitionid,name, type, size, addr);
-		if (uid <= 0)
-		{
-			// Allocation failed, check if we can go lower for another try
-			if ((size > 10000) && ((size - 10000) > original_size - (original_size / 5)))
-			{
-				// Try again with 10kB less
-				size -= 10000;
-			}
-			else
-			{
-				// Limit reached, break out of loop
-				break;
-			}
-		}
+	// amount of free memory, settle for the largest block that fits as long as it is
+	// not under alloc_fallback_percent (80 % by default) of the requested amount.
+	uid = sceKernelAllocPartitionMemory(partitionid, name, type, size, addr);
+	if (uid <= 0 && alloc_fallback_percent > 0 && alloc_fallback_percent < 100) {
+		min = (size / 100) * alloc_fallback_percent
+			+ (size % 100) * alloc_fallback_percent / 100;
+		if (min > 0)
+			uid = alloc_fallback(partitionid, name, type, &size, addr, min);
 	}
-	while (uid <= 0);
 
 	dbg_printf("-> final allocation made for %d of %d requested bytes with result 0x%08X\n", size, original_size, uid);
 
+	/***********************************************************************/
+	/* Succeeded OS alloc.  Record the block in the ledger.                */
+	/* (Don't worry if there's no space to record it, we'll just have to   */
+	/* leak it).                                                           */
+	/***********************************************************************/
 	if (uid > 0)
-	{
-		/***********************************************************************/
-		/* Succeeded OS alloc.  Record the block ID in the tracking list.      */
-		/* (Don't worry if there's no space to record it, we'll just have to   */
-		/* leak it).                                                           */
-		/***********************************************************************/
-		if (osAllocNum < sizeof(osAllocs) / sizeof(SceUID))
-		{
-			osAllocs[osAllocNum] = uid;
-			osAllocNum ++;
-			dbg_printf("Num tracked OS blocks now: %08X\n", osAllocNum);
-		}
-		else
-		{
-			dbg_printf("!!! EXCEEDED OS ALLOC TRACKING ARRAY\n");
-		}
-	}
-	sceKernelSignalSema(globals->memSema, 1);
+		ledger_add(uid, name, size, LEDGER_HOMEBREW);
+
 	return uid;
 }
 
 int _hook_sceKernelFreePartitionMemory(SceUID blockid)
 {
-	int ret;
-	unsigned i;
-	int found = 0;
-
-	hblWaitSema(globals->memSema, 1, 0);
-	ret = sceKernelFreePartitionMemory(blockid);
-
-	/*************************************************************************/
-	/* Remove UID from list of alloc'd mem.                                  */
-	/*************************************************************************/
-	for (i = 0; i < osAllocNum; i++) {
-		if (osAllocs[i] == blockid)
-			found = 1;
-
-		if (found && i < sizeof(osAllocs) / sizeof(SceUID) - 2)
-			osAllocs[i] = osAllocs[i + 1];
-	}
+	if (!pool_free(blockid))
+		return 0;
 
-	if (found)
-		osAllocNum--;
+	return ledger_free(blockid);
+}
 
-	sceKernelSignalSema(globals->memSema, 1);
+void *_hook_sceKernelGetBlockHeadAddr(SceUID blockid)
+{
+	void *p;
 
-	return ret;
+	p = pool_addr(blockid);
+	if (p != NULL)
+		return p;
 
+	return sceKernelGetBlockHeadAddr(blockid);
 }
 
 
@@ -929,17 +1254,18 @@ int _hook_sceKernelFreePartitionMemory(SceUID blockid)
 int _hook_sceKernelCreateCallback(const char *name, SceKernelCallbackFunction func, void *arg)
 {
 	int lrc = sceKernelCreateCallback(name, func, arg);
+	int state;
 
 	dbg_printf("Enter createcallback: %s\n", (u32)name);
 
-	hblWaitSema(globals->cbSema, 1, 0);
+	state = hblLock(globals->cbSema);
 	if (cbcount < MAX_CALLBACKS)
 	{
 		cbids[cbcount] = lrc;
 		cbfuncs[cbcount] = func;
 		cbcount ++;
 	}
-	sceKernelSignalSema(globals->cbSema, 1);
+	hblUnlock(globals->cbSema, state);
 
 	dbg_printf("Exit createcallback: %s ID: %08X\n", (u32) name, lrc);
 
@@ -951,21 +1277,22 @@ int _hook_sceKernelCreateCallback(const char *name, SceKernelCallbackFunction fu
 /*****************************************************************************/
 int _hook_sceKernelRegisterExitCallback(int cbid)
 {
-	int i;
+	int i, state;
 
 	dbg_printf("Enter registerexitCB: %08X\n", cbid);
 
-	hblWaitSema(globals->cbSema, 1, 0);
+	state = hblLock(globals->cbSema);
 	for (i = 0; i < cbcount; i++)
 	{
 		if (cbids[i] == cbid)
 		{
-			dbg_printf("Found matching CB, func: %08X\n", cbfuncs[i]);
 			hook_exit_cb = cbfuncs[i];
 			break;
 		}
 	}
-	sceKernelSignalSema(globals->cbSema, 1);
+	hblUnlock(globals->cbSema, state);
+
+	dbg_printf("Exit callback func: %08X\n", (int)hook_exit_cb);
 
 	dbg_printf("Exit registerexitCB: %08X\n",cbid);
 
@@ -1033,18 +1360,16 @@ int _hook_sceRtcGetCurrentTick(u64 *tick)
 	return _hook_sceRtcGetTick(&time, tick);
 }
 
-//based on http://forums.ps2dev.org/viewtopic.php?t=12490
-int _hook_sceIoLseek32 (SceUID  fd, int offset, int whence)
-{
-	return sceIoLseek(fd, offset, whence);
-}
-
 
 //audio hooks
 
 int _hook_sceAudioChReserve(int channel, int samplecount, int format)
 {
 	int lreturn = sceAudioChReserve(channel,samplecount,format);
+#ifdef MONITOR_AUDIO_THREADS
+	SceUID thid;
+	int state;
+#endif
 
 #ifdef MONITOR_AUDIO_THREADS
 	if (lreturn >= 0)
@@ -1056,9 +1381,10 @@ int _hook_sceAudioChReserve(int channel, int samplecount, int format)
 		}
 		else
 		{
-			hblWaitSema(globals->audioSema, 1, 0);
-			audio_th[lreturn] = sceKernelGetThreadId();
-			sceKernelSignalSema(globals->audioSema, 1);
+			thid = sceKernelGetThreadId();
+			state = hblLock(globals->audioSema);
+			audio_th[lreturn] = thid;
+			hblUnlock(globals->audioSema, state);
 		}
 	}
 #endif
@@ -1111,15 +1437,18 @@ static int _hook_sceAudioOutputPannedBlocking(int channel, int vol, int UNUSED(v
 int _hook_sceAudioChRelease(int channel)
 {
 	int lreturn;
+#ifdef MONITOR_AUDIO_THREADS
+	int state;
+#endif
 
 	lreturn = sceAudioChRelease( channel );
 
 #ifdef MONITOR_AUDIO_THREADS
 	if (lreturn >= 0)
 	{
-		hblWaitSema(globals->audioSema, 1, 0);
+		state = hblLock(globals->audioSema);
 		audio_th[channel] = 0;
-		sceKernelSignalSema(globals->audioSema, 1);
+		hblUnlock(globals->audioSema, state);
 	}
 #endif
 	return lreturn;
@@ -1258,14 +1587,24 @@ static int _hook_sceKernelTryReceiveMsgPipe(SceUID uid, void * message, unsigned
 //
 // Cache
 //
-static void _hook_sceKernelDcacheWritebackAll ()
+static void _hook_sceKernelDcacheWritebackAll()
 {
-	sceKernelDcacheWritebackRange(P2_PTR, P2_SIZE);
+	dcache_wbinv_all();
 }
 
 static void _hook_sceKernelDcacheWritebackInvalidateAll()
 {
-	sceKernelDcacheWritebackInvalidateRange(P2_PTR, P2_SIZE);
+	dcache_wbinv_all();
+}
+
+static void _hook_sceKernelDcacheWritebackRange(const void *p, unsigned int size)
+{
+	dcache_wb_range(p, (const char *)p + size);
+}
+
+static void _hook_sceKernelDcacheWritebackInvalidateRange(const void *p, unsigned int size)
+{
+	dcache_wbinv_range(p, (const char *)p + size);
 }
 
 // ###############
@@ -1373,23 +1712,62 @@ static int _hook_sceAudioOutput2GetRestSample()
 	return sum;
 }
 
-static unsigned int _hook_sceKernelUtilsMt19937UInt(SceKernelUtilsMt19937Context UNUSED(*ctx))
+// MT19937, kept in the caller's context: count is the index of the next
+// word of state to temper, reaching MT_N when the state must be twisted
+#define MT_N 624
+#define MT_M 397
+
+static unsigned int mt_mix(unsigned int hi, unsigned int lo, unsigned int m)
+{
+	unsigned int y = (hi & 0x80000000) | (lo & 0x7FFFFFFF);
+
+	return m ^ (y >> 1) ^ (-(y & 1) & 0x9908B0DF);
+}
+
+// Regenerates the whole state at once
+static void mt_twist(unsigned int *mt)
+{
+	int i;
+
+	for (i = 0; i < MT_N - MT_M; i++)
+		mt[i] = mt_mix(mt[i], mt[i + 1], mt[i + MT_M]);
+	for (; i < MT_N - 1; i++)
+		mt[i] = mt_mix(mt[i], mt[i + 1], mt[i + MT_M - MT_N]);
+	mt[MT_N - 1] = mt_mix(mt[MT_N - 1], mt[0], mt[MT_M - 1]);
+}
+
+static unsigned int _hook_sceKernelUtilsMt19937UInt(SceKernelUtilsMt19937Context *ctx)
 {
-	// (Bill's generator)
-	rdm_seed = (((rdm_seed * 214013L + 2531011L) >> 16) & 0xFFFF);
-	rdm_seed |= ((rdm_seed * 214013L + 2531011L) & 0xFFFF0000);
+	unsigned int y;
+
+	if (ctx->count >= MT_N) {
+		mt_twist(ctx->state);
+		ctx->count = 0;
+	}
+
+	y = ctx->state[ctx->count++];
+	y ^= y >> 11;
+	y ^= (y << 7) & 0x9D2C5680;
+	y ^= (y << 15) & 0xEFC60000;
+	y ^= y >> 18;
 
-	return rdm_seed;
+	return y;
 }
 
 static int _hook_sceKernelUtilsMt19937Init(SceKernelUtilsMt19937Context *ctx, unsigned int seed)
 {
+	unsigned int *mt;
 	int i;
 
-	rdm_seed = seed;
+	if (ctx == NULL)
+		return SCE_KERNEL_ERROR_ILLEGAL_ADDR;
 
-	for (i = 0; i < 624; i++)
-		_hook_sceKernelUtilsMt19937UInt(ctx);
+	mt = ctx->state;
+	mt[0] = seed;
+	for (i = 1; i < MT_N; i++)
+		mt[i] = 1812433253 * (mt[i - 1] ^ (mt[i - 1] >> 30)) + i;
+
+	ctx->count = MT_N;
 
 	return 0;
 }
@@ -1456,6 +1834,9 @@ int _hook_sceUtilityOskInitStart (SceUtilityOskParams *params)
 typedef struct {
 	int nid;
 	int hook[2];
+#ifdef HOOK_PROFILE
+	const char *name;
+#endif
 } hook_t;
 
 static int resolveHook(int *dst, int nid, const hook_t *hook, size_t hookSize)
@@ -1479,6 +1860,9 @@ static int resolveHook(int *dst, int nid, const hook_t *hook, size_t hookSize)
 					if (hook->hook[0]) {
 						dst[0] = hook->hook[0];
 						dst[1] = NOP_ASM;
+#ifdef HOOK_PROFILE
+						hook_profile_wrap(dst, nid, hook->name);
+#endif
 					} else {
 						dst[0] = JR_ASM(REG_RA);
 						dst[1] = globals->nid_table[index].call;
@@ -1490,6 +1874,9 @@ static int resolveHook(int *dst, int nid, const hook_t *hook, size_t hookSize)
 			} else {
 				dst[0] = hook->hook[0];
 				dst[1] = NOP_ASM;
+#ifdef HOOK_PROFILE
+				hook_profile_wrap(dst, nid, hook->name);
+#endif
 
 				return 0;
 			}
@@ -1504,9 +1891,14 @@ resolveHook_cont:
 }
 
 #define HOOK_OK(nid) { (nid), { JR_ASM(REG_RA), LUI_ASM(REG_A0, 0) } }
+#ifdef HOOK_PROFILE
+#define HOOK_ALT_FUNC(nid, alt, func) { (nid), { J_ASM(func), (alt) }, #func }
+#else
 #define HOOK_ALT_FUNC(nid, alt, func) { (nid), { J_ASM(func), (alt) } }
+#endif
 #define HOOK_FUNC(nid, func) HOOK_ALT_FUNC((nid), 0, (func))
-#define HOOK_ALT(nid, alt) HOOK_ALT_FUNC((nid), (alt), 0)
+// No function: the stub becomes the syscall of alt
+#define HOOK_ALT(nid, alt) { (nid), { 0, (alt) } }
 
 int hook(int *dst, int nid)
 {
@@ -1514,6 +1906,7 @@ int hook(int *dst, int nid)
 		HOOK_FUNC(0x1F803938, _hook_sceCtrlReadBufferPositive),
 		HOOK_FUNC(0x237DBD4F, _hook_sceKernelAllocPartitionMemory),
 		HOOK_FUNC(0xB6D61D02, _hook_sceKernelFreePartitionMemory),
+		HOOK_FUNC(0x9D9A5BA1, _hook_sceKernelGetBlockHeadAddr),
 		HOOK_FUNC(0x446D8DE6, _hook_sceKernelCreateThread),
 		HOOK_FUNC(0xF475845D, _hook_sceKernelStartThread),
 		HOOK_FUNC(0xAA73C935, _hook_sceKernelExitThread),
@@ -1560,6 +1953,19 @@ int hook(int *dst, int nid)
 		HOOK_FUNC(0x810C4BC3, _hook_sceIoClose)
 	};
 
+	const hook_t bufioHook[] = {
+		HOOK_FUNC(0x6A638D83, _hook_sceIoRead),
+		HOOK_FUNC(0x42EC03AC, _hook_sceIoWrite),
+		HOOK_FUNC(0x27EB27B8, _hook_sceIoLseek),
+		HOOK_FUNC(0x68963324, _hook_sceIoLseek32),
+		HOOK_FUNC(0xA0B5A7C2, _hook_sceIoReadAsync),
+		HOOK_FUNC(0x0FACAB19, _hook_sceIoWriteAsync),
+		HOOK_FUNC(0x71B19E77, _hook_sceIoLseekAsync),
+		HOOK_FUNC(0x1B385D8F, _hook_sceIoLseek32Async),
+		HOOK_FUNC(0x63632449, _hook_sceIoIoctl),
+		HOOK_FUNC(0xE95A012B, _hook_sceIoIoctlAsync)
+	};
+
 	const hook_t chdirHook[] = {
 		HOOK_FUNC(0x55F4717D, _hook_sceIoChdir),
 		HOOK_FUNC(0x06A70004, _hook_sceIoMkdir),
@@ -1568,6 +1974,16 @@ int hook(int *dst, int nid)
 		HOOK_FUNC(0xB29DDF9C, _hook_sceIoDopen)
 	};
 
+	const hook_t dircacheHook[] = {
+		HOOK_FUNC(0x06A70004, _hook_sceIoMkdir),
+		HOOK_FUNC(0x779103A0, _hook_sceIoRename),
+		HOOK_FUNC(0xF27A9C51, _hook_sceIoRemove),
+		HOOK_FUNC(0x1117C65F, _hook_sceIoRmdir),
+		HOOK_FUNC(0xB29DDF9C, _hook_sceIoDopen),
+		HOOK_FUNC(0xE3EB004C, _hook_sceIoDread),
+		HOOK_FUNC(0xEB092469, _hook_sceIoDclose)
+	};
+
 	const hook_t emuHook[] = {
 		HOOK_FUNC(0xE3EB004C, sceIoDread_Vita),
 		HOOK_FUNC(0xEB092469, sceIoDclose_Vita)
@@ -1584,7 +2000,7 @@ int hook(int *dst, int nid)
 		HOOK_FUNC(0x3FC9AE6A, _hook_sceKernelDevkitVersion),
 		HOOK_FUNC(0xA291F107, hblKernelMaxFreeMemSize),
 		HOOK_FUNC(0x68963324, _hook_sceIoLseek32),
-		HOOK_ALT_FUNC(0x3A622550, 0x1F803938, _hook_sceCtrlReadBufferPositive),
+		HOOK_FUNC(0x3A622550, _hook_sceCtrlPeekBufferPositive),
 		HOOK_FUNC(0x383F7BCC, kill_thread), // sceKernelTerminateDeleteThread
 		HOOK_ALT_FUNC(0xD675EBB8, 0x8F2DF740, _hook_sceKernelSelfStopUnloadModule),
 		HOOK_ALT_FUNC(0x884C9F90, 0x876DBFAD, _hook_sceKernelTrySendMsgPipe),
@@ -1629,15 +2045,14 @@ int hook(int *dst, int nid)
 		HOOK_OK(0xE9D97901), // sceAudioGetChannelRestLen
 		HOOK_ALT(0x8C1009B2, 0x136CAF51),
 		HOOK_ALT_FUNC(0x8C1009B2, 0x13F592BC, _hook_sceAudioOutputBlocking),
-		HOOK_ALT_FUNC(0xB435DEC5, 0x34B9FA9E, _hook_sceKernelDcacheWritebackInvalidateAll),
-		HOOK_ALT(0xB435DEC5, 0x79D1C3FA),
+		HOOK_FUNC(0xB435DEC5, _hook_sceKernelDcacheWritebackInvalidateAll),
 		HOOK_ALT(0x876DBFAD, 0x884C9F90), // Hook sceKernelSendMsgPipe with sceKernelTrySendMsgPipe
 		HOOK_ALT_FUNC(0x647CEF33, 0xB011922F, _hook_sceAudioOutput2GetRestSample),
 		HOOK_FUNC(0x06FB8A63, _hook_sceKernelUtilsMt19937UInt),
 		HOOK_ALT(0x46F186C3, 0x984C27E7), // Hook sceDisplayWaitVblankStartCB with sceDisplayWaitVblankStart
-		HOOK_ALT(0x3EE30821, 0x79D1C3FA), // Hook sceKernelDcacheWritebackRange with sceKernelDcacheWritebackAll
-		HOOK_ALT(0x34B9FA9E, 0xB435DEC5), // Hook sceKernelDcacheWritebackInvalidateRange with sceKernelDcacheWritebackInvalidateAll
-		HOOK_ALT_FUNC(0x79D1C3FA, 0x3EE30821, _hook_sceKernelDcacheWritebackAll),
+		HOOK_FUNC(0x3EE30821, _hook_sceKernelDcacheWritebackRange),
+		HOOK_FUNC(0x34B9FA9E, _hook_sceKernelDcacheWritebackInvalidateRange),
+		HOOK_FUNC(0x79D1C3FA, _hook_sceKernelDcacheWritebackAll),
 		HOOK_ALT(0xE2D56B2D, 0x13F592BC), // Hook sceAudioOutputPanned with sceAudioOutputPannedBlocking
 		HOOK_ALT(0x616403BA, 0x383F7BCC), // Hook sceKernelTerminateThread with sceKernelTerminateDeleteThread
 		HOOK_FUNC(0xF919F628, hblKernelTotalFreeMemSize),
@@ -1664,9 +2079,10 @@ int hook(int *dst, int nid)
 		return 0;
 
 #ifdef NO_SYSCALL_RESOLVER
+	// sceDisplaySetFrameBuf does nothing and succeeds
 	if (!isImported(sceDisplayGetFrameBuf) && nid == 0x289D82FE) {
-		dst[0] = J_ASM(_hook_sceKernelUtilsMt19937Init);
-		dst[1] = NOP_ASM;
+		dst[0] = JR_ASM(REG_RA);
+		dst[1] = LUI_ASM(REG_V0, 0);
 
 		return 0;
 	}
@@ -1691,6 +2107,24 @@ int hook(int *dst, int nid)
 		if (!resolveHook(dst, nid, hookWithOrg, sizeof(hookWithOrg)))
 			return 0;
 
+#ifdef IO_PROFILE
+		// The profiler counts the calls on every descriptor
+		if (!resolveHook(dst, nid, bufioHook, sizeof(bufioHook)))
+			return 0;
+#else
+		if ((io_readahead > 0 || io_writebehind > 0)
+			&& !resolveHook(dst, nid, bufioHook, sizeof(bufioHook)))
+		{
+			return 0;
+		}
+#endif
+
+		if (io_dircache > 0
+			&& !resolveHook(dst, nid, dircacheHook, sizeof(dircacheHook)))
+		{
+			return 0;
+		}
+
 		if (globals->isEmu || !globals->chdir_ok) {
 			if (!resolveHook(dst, nid, chdirHook, sizeof(chdirHook)))
 				return 0;
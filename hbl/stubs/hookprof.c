@@ -0,0 +1,115 @@
+#include <common/utils/cache.h>
+#include <common/utils/string.h>
+#include <common/debug.h>
+#include <common/sdk.h>
+#include <hbl/stubs/hookprof.h>
+
+/*
+ * Each profiled hook gets a trampoline of two instructions:
+ *	j	hook_profile_entry
+ *	ori	$t9, $zero, slot
+ * hook_profile_entry (hookprof_entry.s) saves the argument registers,
+ * calls hook_profile_enter, calls the hook and then hook_profile_leave.
+ * It adds a stack frame, so hooks taking arguments on the stack (more than
+ * eight) must not be profiled.
+ *
+ * The counters are not locked. A call preempted in the middle of an update
+ * may get lost, which is good enough for a profile.
+ */
+typedef struct {
+	int nid;
+	u32 target;
+	const char *name;
+	u32 calls;
+	u32 time;	// Microseconds spent in the hook
+} HookProfile;
+
+void hook_profile_entry();
+
+static HookProfile profiles[HOOK_PROFILE_MAX];
+static u32 trampolines[HOOK_PROFILE_MAX][2];
+static unsigned numProfiles = 0;
+
+static u32 hook_profile_clock()
+{
+	return isImported(sceKernelGetSystemTimeLow) ? sceKernelGetSystemTimeLow() : 0;
+}
+
+// Called by hook_profile_entry. Returns the address of the hook.
+__attribute__((used, externally_visible))
+u32 hook_profile_enter(unsigned slot, u32 *start)
+{
+	profiles[slot].calls++;
+	*start = hook_profile_clock();
+
+	return profiles[slot].target;
+}
+
+__attribute__((used, externally_visible))
+void hook_profile_leave(unsigned slot, u32 start)
+{
+	profiles[slot].time += hook_profile_clock() - start;
+}
+
+void hook_profile_wrap(int *dst, int nid, const char *name)
+{
+	unsigned i;
+	u32 target;
+
+	if (dst == NULL || (dst[0] & 0xFC000000) != J_OPCODE
+		|| !(dst[0] & 0x03FFFFFF))
+	{
+		return;
+	}
+
+	target = ((u32)dst & 0xF0000000) | (dst[0] & 0x03FFFFFF) << 2;
+
+	for (i = 0; i < numProfiles; i++)
+		if (profiles[i].nid == nid && profiles[i].target == target)
+			break;
+
+	if (i >= numProfiles) {
+		if (numProfiles >= HOOK_PROFILE_MAX) {
+			dbg_printf("Hook profile full, 0x%08X not counted\n", nid);
+			return;
+		}
+
+		profiles[i].nid = nid;
+		profiles[i].target = target;
+		profiles[i].name = name;
+		profiles[i].calls = 0;
+		profiles[i].time = 0;
+
+		trampolines[i][0] = J_ASM(hook_profile_entry);
+		trampolines[i][1] = ORI_ASM(REG_T9, REG_ZR, i);
+		synci(trampolines[i], trampolines[i] + 2);
+
+		numProfiles++;
+	}
+
+	dst[0] = J_ASM(trampolines[i]);
+}
+
+void hook_profile_report()
+{
+	// The trampolines refer to the slots, so sort their indices
+	static unsigned char order[HOOK_PROFILE_MAX];
+	HookProfile *p;
+	unsigned i, j, tmp;
+
+	for (i = 0; i < numProfiles; i++) {
+		tmp = i;
+		for (j = i; j > 0 && profiles[order[j - 1]].time < profiles[tmp].time; j--)
+			order[j] = order[j - 1];
+		order[j] = tmp;
+	}
+
+	dbg_printf("Hook profile: NID calls time (us) hook\n");
+	for (i = 0; i < numProfiles; i++) {
+		p = profiles + order[i];
+		dbg_printf("0x%08X %d %d %s\n", p->nid, p->calls, p->time,
+			p->name == NULL ? "?" : p->name);
+	}
+
+	numProfiles = 0;
+}
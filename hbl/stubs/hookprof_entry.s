@@ -0,0 +1,52 @@
+	.text
+	.align	2
+	.set	noat
+	.set	nomips16
+	.set	noreorder
+
+# Reached from a trampoline of hookprof.c with the slot in $t9
+	.globl	hook_profile_entry
+	.ent	hook_profile_entry
+	.type	hook_profile_entry, @function
+hook_profile_entry:
+	addiu	$sp, $sp, -48
+	sw	$ra, 0($sp)
+	sw	$a0, 4($sp)
+	sw	$a1, 8($sp)
+	sw	$a2, 12($sp)
+	sw	$a3, 16($sp)
+	sw	$t0, 20($sp)
+	sw	$t1, 24($sp)
+	sw	$t2, 28($sp)
+	sw	$t3, 32($sp)
+	sw	$t9, 36($sp)
+
+	move	$a0, $t9
+	jal	hook_profile_enter
+	addiu	$a1, $sp, 40
+
+	move	$t9, $v0
+	lw	$a0, 4($sp)
+	lw	$a1, 8($sp)
+	lw	$a2, 12($sp)
+	lw	$a3, 16($sp)
+	lw	$t0, 20($sp)
+	lw	$t1, 24($sp)
+	lw	$t2, 28($sp)
+	jalr	$t9
+	lw	$t3, 32($sp)
+
+	sw	$v0, 4($sp)
+	sw	$v1, 8($sp)
+	lw	$a0, 36($sp)
+	jal	hook_profile_leave
+	lw	$a1, 40($sp)
+
+	lw	$v0, 4($sp)
+	lw	$v1, 8($sp)
+	lw	$ra, 0($sp)
+	jr	$ra
+	addiu	$sp, $sp, 48
+
+	.end	hook_profile_entry
+	.size	hook_profile_entry, .-hook_profile_entry
@@ -55,10 +55,13 @@ static u8 MD5_PADDING[64] = { /* 512 Bits */
 	   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
-static void md5_encode(SceKernelUtilsMd5Context *ctx)
+/*
+ * Processes one 64 bytes block. The PSP is little endian like MD5, so the
+ * block is read as words directly, from the caller's buffer when aligned.
+ */
+static void md5_encode(SceKernelUtilsMd5Context *ctx, const unsigned int *buf)
 {
 	unsigned int a = ctx->h[0], b = ctx->h[1], c = ctx->h[2], d = ctx->h[3];
-	unsigned int *buf = (unsigned int *)ctx->buf;
 
 	/* Round 1 */
 	FF (a, b, c, d, buf[ 0], S11, 0xd76aa478); /* 1 */
@@ -194,16 +197,25 @@ int _hook_sceKernelUtilsMd5BlockUpdate(SceKernelUtilsMd5Context *ctx, u8 *data,
 		memcpy (ctx->buf + ctx->usRemains, data, sizeof(ctx->buf) - ctx->usRemains);
 		data += sizeof(ctx->buf) - ctx->usRemains;
 		size -= sizeof(ctx->buf) - ctx->usRemains;
-		md5_encode(ctx);
+		md5_encode(ctx, (unsigned int *)ctx->buf);
 		ctx->usRemains = 0;
 		ctx->usComputed += sizeof(ctx->buf);
 	}
-	while (size >= sizeof(ctx->buf)) {
-		memcpy (ctx->buf, data, sizeof(ctx->buf));
-		data += sizeof(ctx->buf);
-		size -= sizeof(ctx->buf);
-		md5_encode(ctx);
-		ctx->usComputed += sizeof(ctx->buf);
+	if (((uintptr_t)data & 3) == 0) {
+		while (size >= sizeof(ctx->buf)) {
+			md5_encode(ctx, (unsigned int *)data);
+			data += sizeof(ctx->buf);
+			size -= sizeof(ctx->buf);
+			ctx->usComputed += sizeof(ctx->buf);
+		}
+	} else {
+		while (size >= sizeof(ctx->buf)) {
+			memcpy (ctx->buf, data, sizeof(ctx->buf));
+			data += sizeof(ctx->buf);
+			size -= sizeof(ctx->buf);
+			md5_encode(ctx, (unsigned int *)ctx->buf);
+			ctx->usComputed += sizeof(ctx->buf);
+		}
 	}
 	memcpy(ctx->buf, data, size);
 	ctx->usRemains = size;
@@ -213,6 +225,7 @@ int _hook_sceKernelUtilsMd5BlockUpdate(SceKernelUtilsMd5Context *ctx, u8 *data,
 
 int _hook_sceKernelUtilsMd5BlockResult(SceKernelUtilsMd5Context *ctx, u8 *digest)
 {
+	u64 bits;
 	int i;
 
 	if (ctx == NULL || digest == NULL)
@@ -220,7 +233,7 @@ int _hook_sceKernelUtilsMd5BlockResult(SceKernelUtilsMd5Context *ctx, u8 *digest
 
 	if (ctx->usRemains + 1 > 56) { /* We have to create another block */
 		memcpy(ctx->buf + ctx->usRemains, MD5_PADDING, sizeof(ctx->buf) - ctx->usRemains);
-		md5_encode(ctx);
+		md5_encode(ctx, (unsigned int *)ctx->buf);
 		memset(ctx->buf, 0, 56);
 		/*memcpy(ctx->buf, MD5_PADDING + 1, 56);*/
 	} else
@@ -229,19 +242,15 @@ int _hook_sceKernelUtilsMd5BlockResult(SceKernelUtilsMd5Context *ctx, u8 *digest
 	ctx->usComputed += ctx->usRemains;
 	ctx->usRemains = 0;
 
-	/* Proceed final block */
-	//md5_addsize(ctx->buf, 56, ctx->usComputed);
-	i = 56;
-	ctx->buf[i++] = (u8)((ctx->usComputed << 3) & 0xFF);
-	ctx->buf[i++] = (u8)((ctx->usComputed >> 5) & 0xFF);
-	ctx->buf[i++] = (u8)((ctx->usComputed >> 13) & 0xFF);
-	ctx->buf[i++] = (u8)((ctx->usComputed >> 21) & 0xFF);
-	ctx->buf[i++] = 0;
-	ctx->buf[i++] = 0;
-	ctx->buf[i++] = 0;
-	ctx->buf[i++] = 0;
-
-	md5_encode(ctx);
+	/* Proceed final block, whose length is counted in ullTotalLen
+	 * because usComputed wraps after 64 KiB */
+	bits = ctx->ullTotalLen << 3;
+	for (i = 56; i < 64; i++) {
+		ctx->buf[i] = (u8)bits;
+		bits >>= 8;
+	}
+
+	md5_encode(ctx, (unsigned int *)ctx->buf);
 
 	/* update digest */
 	for (i = 0; i < 4; i++)
@@ -0,0 +1,213 @@
+#include <common/utils/string.h>
+#include <common/debug.h>
+#include <common/globals.h>
+#include <common/ledger.h>
+#include <common/memory.h>
+#include <common/sdk.h>
+#include <hbl/stubs/pool.h>
+
+// Smallest size class, which is also the granularity of the others
+#define POOL_MIN_CLASS 16
+
+// Objects per slab of the smallest class
+#define POOL_SLOTS (POOL_SLAB_SIZE / POOL_MIN_CLASS)
+
+/*
+ * Synthetic UIDs are POOL_UID_TAG | slab << 12 | slot. Kernel UIDs never
+ * have these high bits, and a tagged UID is only accepted if its slot is
+ * actually in use.
+ */
+#define POOL_UID_TAG 0x7F000000
+#define POOL_UID_MASK 0xFF000000
+
+typedef struct {
+	SceUID uid;		// Partition block, 0 if the slab is unused
+	char *base;
+	SceSize size;		// Size class of the objects
+	unsigned next;		// Slots below this have been handed out once
+	unsigned used;		// Slots currently in use
+	int free;		// First slot of the free list, -1 if empty
+	u32 map[POOL_SLOTS / 32];	// In-use bitmap
+} PoolSlab;
+
+static PoolSlab slabs[POOL_MAX_SLABS];
+
+static SceSize pool_class(SceSize size)
+{
+	SceSize c;
+
+	for (c = POOL_MIN_CLASS; c < size; c <<= 1);
+
+	return c;
+}
+
+// Takes a slot of the slab. Must be called with the pool locked.
+static SceUID slab_take(PoolSlab *slab, int i)
+{
+	int slot;
+
+	if (slab->free >= 0) {
+		slot = slab->free;
+		slab->free = *(int *)(slab->base + slot * slab->size);
+	} else if (slab->next < POOL_SLAB_SIZE / slab->size)
+		slot = slab->next++;
+	else
+		return -1;
+
+	slab->map[slot >> 5] |= 1 << (slot & 31);
+	slab->used++;
+
+	return POOL_UID_TAG | (i << 12) | slot;
+}
+
+// Returns the slab of a synthetic UID, or NULL. Must be called with the pool locked.
+static PoolSlab *pool_find(SceUID uid, int *slot)
+{
+	PoolSlab *slab;
+	int i;
+
+	if ((uid & POOL_UID_MASK) != POOL_UID_TAG)
+		return NULL;
+
+	i = (uid >> 12) & 0xFFF;
+	*slot = uid & 0xFFF;
+	if (i >= POOL_MAX_SLABS)
+		return NULL;
+
+	slab = slabs + i;
+	if (!slab->uid || !(slab->map[*slot >> 5] & (1 << (*slot & 31))))
+		return NULL;
+
+	return slab;
+}
+
+SceUID pool_alloc(SceSize size)
+{
+	PoolSlab *slab;
+	SceUID block, uid;
+	void *base;
+	int i, state;
+
+	if (size == 0 || size > POOL_MAX_CLASS)
+		return SCE_KERNEL_ERROR_ILLEGAL_ARGUMENT;
+
+	size = pool_class(size);
+
+	state = hblLock(globals->memSema);
+
+	for (i = 0; i < POOL_MAX_SLABS; i++)
+		if (slabs[i].uid && slabs[i].size == size) {
+			uid = slab_take(slabs + i, i);
+			if (uid >= 0) {
+				hblUnlock(globals->memSema, state);
+				return uid;
+			}
+		}
+
+	hblUnlock(globals->memSema, state);
+
+	// Every slab of this class is full, start a new one
+	block = ledger_alloc(LEDGER_HOMEBREW, "HBL Pool",
+		PSP_SMEM_Low, POOL_SLAB_SIZE, NULL);
+	if (block < 0)
+		return block;
+
+	base = sceKernelGetBlockHeadAddr(block);
+	if (base == NULL) {
+		ledger_free(block);
+		return SCE_KERNEL_ERROR_ERROR;
+	}
+
+	state = hblLock(globals->memSema);
+
+	for (i = 0; i < POOL_MAX_SLABS; i++)
+		if (!slabs[i].uid)
+			break;
+
+	if (i >= POOL_MAX_SLABS) {
+		hblUnlock(globals->memSema, state);
+		ledger_free(block);
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+	}
+
+	slab = slabs + i;
+	memset(slab->map, 0, sizeof(slab->map));
+	slab->uid = block;
+	slab->base = base;
+	slab->size = size;
+	slab->next = 0;
+	slab->used = 0;
+	slab->free = -1;
+
+	uid = slab_take(slab, i);
+
+	hblUnlock(globals->memSema, state);
+
+	dbg_printf("New %d bytes pool slab at 0x%08X\n", size, (int)base);
+
+	return uid;
+}
+
+int pool_free(SceUID uid)
+{
+	PoolSlab *slab;
+	SceUID block;
+	int slot, state;
+
+	if ((uid & POOL_UID_MASK) != POOL_UID_TAG)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	state = hblLock(globals->memSema);
+
+	slab = pool_find(uid, &slot);
+	if (slab == NULL) {
+		hblUnlock(globals->memSema, state);
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+	}
+
+	slab->map[slot >> 5] &= ~(1 << (slot & 31));
+	*(int *)(slab->base + slot * slab->size) = slab->free;
+	slab->free = slot;
+	slab->used--;
+
+	// Give empty slabs back so other size classes can use the memory
+	block = 0;
+	if (slab->used == 0) {
+		block = slab->uid;
+		slab->uid = 0;
+	}
+
+	hblUnlock(globals->memSema, state);
+
+	if (block)
+		ledger_free(block);
+
+	return 0;
+}
+
+void *pool_addr(SceUID uid)
+{
+	PoolSlab *slab;
+	void *p;
+	int slot, state;
+
+	if ((uid & POOL_UID_MASK) != POOL_UID_TAG)
+		return NULL;
+
+	state = hblLock(globals->memSema);
+
+	slab = pool_find(uid, &slot);
+	p = slab == NULL ? NULL : slab->base + slot * slab->size;
+
+	hblUnlock(globals->memSema, state);
+
+	return p;
+}
+
+void pool_reset()
+{
+	int i;
+
+	for (i = 0; i < POOL_MAX_SLABS; i++)
+		slabs[i].uid = 0;
+}
@@ -4,7 +4,9 @@
 #include <common/debug.h>
 #include <common/globals.h>
 #include <common/sdk.h>
+#include <common/trace.h>
 #include <hbl/modmgr/elf.h>
+#include <hbl/modmgr/memindex.h>
 #include <hbl/modmgr/modmgr.h>
 #include <hbl/stubs/hook.h>
 #include <hbl/stubs/resolve.h>
@@ -36,6 +38,25 @@ static int get_jump_from_export(int *dst, u32 nid, SceLibraryEntryTable *pexport
 	return SCE_KERNEL_ERROR_ERROR;
 }
 
+#ifndef NO_SYSCALL_RESOLVER
+// The stub entry that getNetLibStubInfo looks for lies 0x80 bytes before
+// the name in the module info of sceNet_Library
+static tStubEntry *findNetLib()
+{
+	const SceModuleInfo *info;
+	const char *name;
+
+	info = memindex_add("sceNet_Library");
+	if (info != NULL) {
+		name = info->modname;
+		if (!strcmp(name + 0x34, "sceNetIfhandle_lib"))
+			return (void *)(name - 0x80);
+	}
+
+	return getNetLibStubInfo();
+}
+#endif
+
 // Resolves imports in ELF's program section already loaded in memory
 int resolve_imports(tStubEntry *pstub_entry, unsigned int stubs_size)
 {
@@ -60,7 +81,7 @@ int resolve_imports(tStubEntry *pstub_entry, unsigned int stubs_size)
 	if (res)
 		return res;
 
-	netLib = getNetLibStubInfo();
+	netLib = findNetLib();
 	if (netLib == NULL)
 		return SCE_KERNEL_ERROR_ERROR;
 #endif
@@ -90,6 +111,7 @@ int resolve_imports(tStubEntry *pstub_entry, unsigned int stubs_size)
 
 			for (i = 0; i < pstub_entry->stub_size; i++) {
 				get_jump_from_export(cur_call, *cur_nid, utility_exp);
+				trace_event(TRACE_NID, *cur_nid, (u32)cur_call, cur_call[1]);
 
 				cur_nid++;
 				cur_call += 2;
@@ -102,8 +124,9 @@ int resolve_imports(tStubEntry *pstub_entry, unsigned int stubs_size)
 					NID_DBG_PRINTF("Index for NID on table: %d\n", nid_index);
 					cur_call[0] = JR_ASM(REG_RA);
 					cur_call[1] = globals->nid_table[nid_index].call;
-				} else
-					hook(cur_call, *cur_nid);
+					trace_event(TRACE_NID, *cur_nid, (u32)cur_call, cur_call[1]);
+				} else if (!hook(cur_call, *cur_nid))
+					trace_event(TRACE_HOOK, *cur_nid, (u32)cur_call, cur_call[0]);
 
 				cur_nid++;
 				cur_call += 2;
@@ -113,9 +136,15 @@ int resolve_imports(tStubEntry *pstub_entry, unsigned int stubs_size)
 			if (res)
 				dbg_printf("warning: failed to resolve syscall: 0x%08X\n", res);
 
-			for (i = 0; i < pstub_entry->stub_size; i++)
-				hook((int32_t *)pstub_entry->jump_p + i * 2,
-					((int32_t *)pstub_entry->nid_p)[i]);
+			for (i = 0; i < pstub_entry->stub_size; i++) {
+				if (hook(cur_call, *cur_nid))
+					trace_event(TRACE_NID, *cur_nid, (u32)cur_call, cur_call[1]);
+				else
+					trace_event(TRACE_HOOK, *cur_nid, (u32)cur_call, cur_call[0]);
+
+				cur_nid++;
+				cur_call += 2;
+			}
 #endif
 		}
 	}
@@ -1,22 +1,46 @@
 #ifndef ELOADER_DEBUG
 #define ELOADER_DEBUG
 
+#include <sys/types.h>
 #include <stdarg.h>
 
 #define PSPLINK_OUT 2
 
 #define DBG_PATH HBL_ROOT"DBGLOG"
 
+// Size of the log ring buffer, must be a power of 2
+#define DBG_LOG_SIZE 16384
+
+// Pending bytes at which the ring buffer is written out
+#define DBG_LOG_FLUSH (DBG_LOG_SIZE / 2)
+
 #ifdef DEBUG
 void dbg_puts(const char *s);
+// Appends n characters of s to stdout and the log file, without a newline
+void dbg_write(const char *s, size_t n);
 void dbg_vprintf(const char *fmt, va_list va);
 void dbg_printf(const char *fmt, ...);
 #else
 #define dbg_puts(s)
+#define dbg_write(s, n)
 #define dbg_vprintf(fmt, va)
 #define dbg_printf(...)
 #endif
 
+#if defined(DEBUG) && !defined(DEBUG_SYNC)
+// Starts buffering the log in the given storage, whose size must be a
+// power of 2. Until this is called, every line is written out at once, so
+// the loader can share the code without carrying the buffer.
+void dbg_log_init(char *buf, size_t size);
+
+// Writes out the buffered log. Call it at phase boundaries and before
+// anything that may not return.
+void dbg_flush();
+#else
+#define dbg_log_init(buf, size)
+#define dbg_flush()
+#endif
+
 #ifdef NID_DEBUG
 #define NID_DBG_PRINTF(...) dbg_printf(__VA_ARGS__)
 #else
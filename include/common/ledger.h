@@ -0,0 +1,48 @@
+#ifndef COMMON_LEDGER_H
+#define COMMON_LEDGER_H
+
+#include <common/sdk.h>
+
+// Maximum number of partition blocks tracked at once
+#define LEDGER_MAX 512
+
+// Characters of the block name kept for reports, including the terminator
+#define LEDGER_NAME_LEN 11
+
+// Who is responsible for freeing a block
+typedef enum {
+	LEDGER_HBL = 0,		// Lives as long as HBL, never reported
+	LEDGER_LOADER = 1,	// Transient buffer of the module loader
+	LEDGER_HOMEBREW = 2	// Allocated by or for the running homebrew
+} LedgerOwner;
+
+typedef struct {
+	SceUID uid;
+	SceSize size;
+	unsigned char owner;
+	char name[LEDGER_NAME_LEN];
+} LedgerEntry;
+
+// Starts tracking with the given storage. Until this is called, every
+// ledger function only forwards to the partition allocator, so the loader
+// can share the code without carrying the table.
+void ledger_init(LedgerEntry *table, unsigned max);
+
+// Records a block. Returns 0, or SCE_KERNEL_ERROR_NO_MEMORY if the ledger
+// is full (the block is then simply not tracked).
+int ledger_add(SceUID uid, const char *name, SceSize size, LedgerOwner owner);
+
+// Forgets a block. Returns 0 if it was tracked.
+int ledger_remove(SceUID uid);
+
+// sceKernelAllocPartitionMemory on partition 2 + ledger_add
+SceUID ledger_alloc(LedgerOwner owner, const char *name, int type, SceSize size, void *addr);
+
+// sceKernelFreePartitionMemory + ledger_remove
+int ledger_free(SceUID uid);
+
+// Reports and frees every block not owned by HBL in one pass.
+// Returns the number of loader blocks found, which are HBL leaks.
+int ledger_cleanup();
+
+#endif
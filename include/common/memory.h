@@ -7,6 +7,19 @@
 /* Overrides of sce functions to avoid syscall estimates */
 SceSize hblKernelMaxFreeMemSize();
 SceSize hblKernelTotalFreeMemSize();
+int hblWaitSema(SceUID semaid, int signal, SceUInt *timeout);
+
+// hblLock() state when the semaphore was taken instead of masking interrupts
+#define HBL_LOCK_SEMA (-1)
+
+/*
+ * Short critical sections on HBL data. Interrupts are masked when
+ * Kernel_Library is available, so the section must not block, print or
+ * do I/O. The semaphore is only used as a fallback, or always when built
+ * with SEMA_LOCKS=1 for debugging.
+ */
+int hblLock(SceUID semaid);
+void hblUnlock(SceUID semaid, int state);
 int kill_thread(SceUID thid);
 void subinterrupthandler_cleanup();
 void UnloadModules();
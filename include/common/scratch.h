@@ -0,0 +1,30 @@
+#ifndef COMMON_SCRATCH_H
+#define COMMON_SCRATCH_H
+
+#include <common/sdk.h>
+
+// Size of the arena allocated at boot
+#define SCRATCH_SIZE (16 * 1024)
+
+// The arena never grows past this, bigger demands get blocks of their own
+#define SCRATCH_MAX_SIZE (128 * 1024)
+
+// Blocks that can be held at once when the arena is exhausted
+#define SCRATCH_OVERFLOW_MAX 4
+
+// Allocates the arena. Until this is called, every request gets its own
+// partition block. The loader links loader/scratch.c instead, which does
+// only that, so that it carries neither the arena nor the ledger.
+int scratch_init(SceSize size);
+
+// Returns a buffer that lives until it is popped or the arena is reset
+void *scratch_alloc(SceSize size);
+
+// Releases the most recent buffer and anything allocated after it
+void scratch_pop(void *p);
+
+// Releases everything. If the last load did not fit in the arena,
+// grows it so the next one does.
+void scratch_reset();
+
+#endif
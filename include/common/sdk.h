@@ -67,17 +67,20 @@ typedef unsigned char byte;
 #define REG_ZR (0)
 #define REG_V0 (2)
 #define REG_A0 (4)
+#define REG_T9 (25)
 #define REG_RA (31)
 
 #define J_OPCODE (0x08000000)
 #define JR_OPCODE (0x00000008)
 #define LUI_OPCODE (0x3C000000)
+#define ORI_OPCODE (0x34000000)
 #define SLL_OPCODE (0x00000000)
 #define SYSCALL_OPCODE (0x0000000C)
 
 #define J_ASM(t) (J_OPCODE | (u32)(t) >> 2)
 #define JR_ASM(r) (JR_OPCODE | (u8)(r) << 21)
 #define LUI_ASM(r, n) (LUI_OPCODE | (u8)(r) << 16 | (u16)(n))
+#define ORI_ASM(t, s, n) (ORI_OPCODE | (u8)(s) << 21 | (u8)(t) << 16 | (u16)(n))
 #define SLL_ASM(d, t, s) (SLL_OPCODE | (u8)(t) << 16 | (u8)(d) << 11 | (u8)(s) << 6)
 #define SYSCALL_ASM(c) (SYSCALL_OPCODE | (u32)(c) << 6)
 #define NOP_ASM SLL_ASM(REG_ZR, REG_ZR, 0)
@@ -0,0 +1,64 @@
+#ifndef COMMON_TRACE_H
+#define COMMON_TRACE_H
+
+#include <common/sdk.h>
+
+#define TRACE_PATH HBL_ROOT"TRACE.BIN"
+
+// Records kept in RAM before they are written out, must be a power of 2
+#define TRACE_MAX 1024
+
+// First word of the file, "HBLT" read as a little endian word
+#define TRACE_MAGIC 0x544C4248
+#define TRACE_VERSION 1
+
+// Event IDs. The values are stored in the file and decoded by
+// tools/decode_trace.rb, so only ever append to this list.
+typedef enum {
+	TRACE_LOST = 0,		// records dropped
+	TRACE_MODULE_LOAD = 1,	// module ID, address, size
+	TRACE_MODULE_START = 2,	// module ID, entry point, result
+	TRACE_NID = 3,		// NID, stub address, second stub word
+	TRACE_HOOK = 4,		// NID, stub address, first stub word
+	TRACE_ALLOC = 5,	// UID, size, owner
+	TRACE_FREE = 6,		// UID
+	TRACE_THREAD_CREATE = 7,	// thread ID, entry point, priority
+	TRACE_THREAD_START = 8,	// thread ID
+	TRACE_THREAD_EXIT = 9	// thread ID, exit status
+} TraceEvent;
+
+// The file is a TraceHeader followed by TraceRecords, all little endian
+typedef struct {
+	u32 magic;
+	u16 version;
+	u16 record_size;
+	u32 tick_rate;		// ticks per second
+} TraceHeader;
+
+typedef struct {
+	u16 event;
+	u16 reserved;
+	u32 tick;
+	u32 args[3];
+} TraceRecord;
+
+#ifdef TRACE
+// Truncates the trace file and starts recording into the given storage,
+// whose number of records must be a power of 2. Until this is called,
+// events are discarded, so the loader can share the code without
+// carrying the buffer.
+void trace_init(TraceRecord *buf, unsigned num);
+
+// Records an event. Never formats, blocks or does I/O unless the buffer
+// needs to be written out. Must not be called with memSema locked.
+void trace_event(TraceEvent event, u32 a, u32 b, u32 c);
+
+// Appends the recorded events to the trace file
+void trace_flush();
+#else
+#define trace_init(buf, num)
+#define trace_event(event, a, b, c)
+#define trace_flush()
+#endif
+
+#endif
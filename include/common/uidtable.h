@@ -0,0 +1,34 @@
+#ifndef COMMON_UIDTABLE_H
+#define COMMON_UIDTABLE_H
+
+#include <common/sdk.h>
+
+/*
+ * Open-addressed hash table of entries keyed by UID, with linear probing.
+ * Each entry starts with its SceUID, 0 marking an empty slot. The table
+ * holds up to 3/4 of its slots so that probes stay short.
+ */
+typedef struct {
+	void *entries;
+	size_t size;	// Size of an entry
+	unsigned bits;	// log2 of the number of slots
+	unsigned num;	// Entries in use
+} UidTable;
+
+#define UIDTABLE_SLOTS(t) (1U << (t)->bits)
+
+// Returns the entry of uid, or NULL
+void *uidtable_find(const UidTable *t, SceUID uid);
+
+// Returns the entry of uid, creating it zeroed if needed. Returns NULL if
+// the table is full.
+void *uidtable_add(UidTable *t, SceUID uid);
+
+// Removes the entry of uid. Entries may move, so pointers returned
+// before are invalid.
+void uidtable_remove(UidTable *t, SceUID uid);
+
+// Removes every entry
+void uidtable_clear(UidTable *t);
+
+#endif
@@ -4,4 +4,10 @@
 
 void synci(const void *top, const void *end);
 
+// Data cache maintenance without the kernel. Ranges larger than the 16kB
+// data cache fall back to dcache_wbinv_all.
+void dcache_wbinv_all();
+void dcache_wb_range(const void *top, const void *end);
+void dcache_wbinv_range(const void *top, const void *end);
+
 #endif
@@ -10,6 +10,9 @@ void *memset(void *s, int c, size_t n);
 // Copies one memory buffer into another
 void *memcpy(void *dst, const void *src, size_t n);
 
+// Compares two memory buffers, returns 0 if both equal
+int memcmp(const void *s1, const void *s2, size_t n);
+
 //Scan s for the character.  When this loop is finished,
 //    s will either point to the end of the string or the
 //    character we were looking for
@@ -29,8 +32,21 @@ char *strcpy(char *dst, const char *src);
 // Returns string length
 size_t strlen(const char *s);
 
-// limited sprintf function - avoids pulling in large library
-void _vfprintf(void (* f)(int), const char *fmt, va_list va);
+// Size of the stack buffers the printf functions format into
+#define FORMAT_BUF_SIZE 128
+
+// Receives formatted text a span at a time. s is NUL terminated at s[n].
+typedef void (* FormatSink)(const char *s, size_t n, void *arg);
+
+// limited vsnprintf - avoids pulling in large library
+// Supports %d, %X and %s, with an optional zero padded width ("%08X").
+// Formats into buf (size must be at least 2). Whenever it fills up, its
+// contents are passed to sink and formatting continues from the start;
+// the last span is passed when done. Without a sink the output is
+// truncated instead. buf is always NUL terminated. Returns the number of
+// characters produced.
+int _vformat(char *buf, size_t size, FormatSink sink, void *arg,
+	const char *fmt, va_list va);
 void _sprintf(char *s, const char *fmt, ...);
 
 #endif
@@ -18,6 +18,13 @@ extern int num_pend_th;
 extern int num_run_th;
 extern int num_exit_th;
 
+// Event flag waking wait_for_eboot_end, -1 if it could not be created
+extern SceUID exit_evf;
+#define EXIT_EVF_THREADS 1	// The last running thread exited
+#define EXIT_EVF_GAME 2	// sceKernelExitGame was called
+#define EXIT_EVF_BUTTONS 4	// The force-exit combo is held
+#define EXIT_EVF_ALL (EXIT_EVF_THREADS | EXIT_EVF_GAME | EXIT_EVF_BUTTONS)
+
 extern u32 gp;
 extern u32 *entry_point;
 
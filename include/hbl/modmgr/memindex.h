@@ -0,0 +1,31 @@
+#ifndef HBL_MEMINDEX_H
+#define HBL_MEMINDEX_H
+
+#include <common/sdk.h>
+
+// Maximum number of modules remembered at once
+#define MEMINDEX_MAX 32
+
+typedef struct {
+	const SceModuleInfo *info;
+	SceUID modid;	// Module holding info when it was found
+} MemIndexEntry;
+
+// Starts remembering modules with the given storage. Until this is called,
+// nothing is remembered and callers scan memory themselves.
+void memindex_init(MemIndexEntry *table, unsigned max);
+
+// Returns the module info of a loaded module, searching memory for its name
+// only if it is not remembered yet, or NULL if it can't be found. The
+// export and stub ranges of the info then bound any further lookup.
+const SceModuleInfo *memindex_add(const char *module);
+
+// Returns the module info of a remembered module that is still loaded,
+// or NULL
+const SceModuleInfo *memindex_find(const char *module);
+
+// Forgets the modules that are no longer loaded. Call it after unloading
+// modules.
+void memindex_prune();
+
+#endif
@@ -12,10 +12,30 @@
 #define OVERRIDE 1
 #define GENERIC_SUCCESS -1
 
+// Smallest share of a failed partition allocation the hook may return instead
+#define ALLOC_FALLBACK_PERCENT 80
+
+// Largest partition allocation served from the small-block pool
+#define ALLOC_POOL_THRESHOLD 0
+
+// Size of the read-ahead window of files opened read-only, 0 to disable
+#define IO_READAHEAD 0
+
+// Size of the write-behind buffer of files opened for writing, 0 to disable
+#define IO_WRITEBEHIND 0
+
+// Size of the buffer holding each cached directory listing, 0 to disable
+#define IO_DIRCACHE 0
+
 extern int override_sceIoMkdir;
 extern int override_sceCtrlPeekBufferPositive;
 extern int return_to_xmb_on_exit;
 extern unsigned int force_exit_buttons;
+extern int alloc_fallback_percent;
+extern int alloc_pool_threshold;
+extern int io_readahead;
+extern int io_writebehind;
+extern int io_dircache;
 extern char hb_fname[];
 
 
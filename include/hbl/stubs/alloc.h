@@ -0,0 +1,15 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <common/sdk.h>
+
+// Partition blocks are handed out in units of 256 bytes
+#define PARTITION_GRANULARITY 256
+
+// Called when an allocation of *size bytes failed. Allocates the largest
+// size between min and *size that fits, to within PARTITION_GRANULARITY,
+// and stores it in *size. Returns the block or the error of the floor.
+SceUID alloc_fallback(SceUID partitionid, const char *name, int type,
+	SceSize *size, void *addr, SceSize min);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef BUFIO_H
+#define BUFIO_H
+
+#include <common/sdk.h>
+
+// Maximum number of descriptors buffered at once
+#define BUFIO_MAX 8
+
+// Attaches a read-ahead window to a descriptor opened read-only, or a
+// write-behind buffer to one opened for writing. Only files on ms0: and
+// ef0: are buffered.
+void bufio_open(SceUID fd, const char *path, int flags);
+
+// Writes out the pending data of a descriptor
+int bufio_flush(SceUID fd);
+
+// Writes out the pending data of every descriptor. Only call it once the
+// homebrew threads are dead, since it ignores their claims.
+void bufio_flush_all();
+
+// Writes out the pending data of a descriptor, moves the kernel position
+// to the one the homebrew sees and stops buffering the descriptor
+int bufio_detach(SceUID fd);
+
+// Forgets every window. Their blocks are freed by the ledger.
+void bufio_reset();
+
+int _hook_sceIoRead(SceUID fd, void *data, SceSize size);
+int _hook_sceIoWrite(SceUID fd, const void *data, SceSize size);
+SceOff _hook_sceIoLseek(SceUID fd, SceOff offset, int whence);
+int _hook_sceIoLseek32(SceUID fd, int offset, int whence);
+int _hook_sceIoReadAsync(SceUID fd, void *data, SceSize size);
+int _hook_sceIoWriteAsync(SceUID fd, const void *data, SceSize size);
+int _hook_sceIoLseekAsync(SceUID fd, SceOff offset, int whence);
+int _hook_sceIoLseek32Async(SceUID fd, int offset, int whence);
+int _hook_sceIoIoctl(SceUID fd, unsigned int cmd, void *indata, int inlen, void *outdata, int outlen);
+int _hook_sceIoIoctlAsync(SceUID fd, unsigned int cmd, void *indata, int inlen, void *outdata, int outlen);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef DIRCACHE_H
+#define DIRCACHE_H
+
+#include <common/sdk.h>
+
+// Maximum number of directory listings kept at once
+#define DIRCACHE_MAX 4
+
+// Maximum number of cached listings being read at once
+#define DIRCACHE_HANDLES 8
+
+// Longer directory paths are not cached
+#define DIRCACHE_PATH_LEN 128
+
+// Returns a synthetic UID reading the cached listing of path, or 0 if it
+// is not cached
+SceUID dircache_open(const char *path);
+
+// Starts recording the listing of path as the homebrew reads fd. dots is
+// the number of leading entries the kernel does not return itself.
+void dircache_fill(SceUID fd, const char *path, unsigned dots);
+
+// Records what sceIoDread returned for fd
+void dircache_record(SceUID fd, const SceIoDirent *dir, int r);
+
+// sceIoDread on a synthetic UID. Returns SCE_KERNEL_ERROR_UNKNOWN_UID if
+// fd does not belong to the cache. Long names are read from the kernel.
+int dircache_read(SceUID fd, SceIoDirent *dir);
+
+// Releases a synthetic UID, or stops recording a kernel descriptor.
+// Returns SCE_KERNEL_ERROR_UNKNOWN_UID if fd does not belong to the cache.
+int dircache_close(SceUID fd);
+
+// Forgets the listings that a change to path may affect. Relative paths
+// can't be compared, so they forget everything.
+void dircache_invalidate(const char *path);
+
+// Forgets every listing. Their blocks are freed by the ledger.
+void dircache_reset();
+
+#endif
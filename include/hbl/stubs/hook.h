@@ -39,9 +39,27 @@ extern int _hook_sceKernelExitGame_IsCalled;
 
 //Own functions
 void threads_cleanup();
-void ram_cleanup();
+int ram_cleanup();
 void files_cleanup();
 
+// Reads the pad with whatever HBL imports, and wakes wait_for_eboot_end
+// if the force-exit combo is held. Returns 1 if it is.
+int sample_pad(SceCtrlData *dst);
+
+#ifdef IO_PROFILE
+typedef enum {
+	IO_PROFILE_READ,
+	IO_PROFILE_WRITE,
+	IO_PROFILE_SEEK
+} IoProfileOp;
+
+// Time base of the profiler, in microseconds
+u32 io_profile_clock();
+
+// Charges a call that started at start to the file of fd
+void io_profile_add(SceUID fd, IoProfileOp op, int result, u32 start);
+#endif
+
 /* Declarations */
 //files imported by Patapon but can't find proper .h file
 int scePower_EBD177D6(int pllfreq, int cpufreq, int busfreq);
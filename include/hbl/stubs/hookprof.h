@@ -0,0 +1,16 @@
+#ifndef HOOKPROF_H
+#define HOOKPROF_H
+
+#include <common/sdk.h>
+
+// Maximum number of hooks counted at once
+#define HOOK_PROFILE_MAX 128
+
+// Makes the stub at dst, which jumps to the hook of nid, go through a
+// counting trampoline instead
+void hook_profile_wrap(int *dst, int nid, const char *name);
+
+// Logs the counts from the most to the least time spent, and forgets them
+void hook_profile_report();
+
+#endif
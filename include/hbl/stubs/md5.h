@@ -36,14 +36,14 @@
  * This implementation is using 32 bits long values for sizes
  */
 
-/* Basic md5 functions */
-#define F(x,y,z) ((x & y) | (~x & z))
-#define G(x,y,z) ((x & z) | (~z & y))
+/* Basic md5 functions, F and G in the forms that need no complement */
+#define F(x,y,z) (z ^ (x & (y ^ z)))
+#define G(x,y,z) (y ^ (z & (x ^ y)))
 #define H(x,y,z) (x ^ y ^ z)
 #define I(x,y,z) (y ^ (x | ~z))
 
-/* Rotate left 32 bits values (words) */
-#define ROTATE_LEFT(w,s) ((w << s) | ((w & 0xFFFFFFFF) >> (32 - s)))
+/* Rotate left 32 bits values (words), which GCC turns into rotr */
+#define ROTATE_LEFT(w,s) (((w) << (s)) | ((w) >> (32 - (s))))
 
 #define FF(a,b,c,d,x,s,t) (a = b + ROTATE_LEFT((a + F(b,c,d) + x + t), s))
 #define GG(a,b,c,d,x,s,t) (a = b + ROTATE_LEFT((a + G(b,c,d) + x + t), s))
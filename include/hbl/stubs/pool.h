@@ -0,0 +1,30 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <common/sdk.h>
+
+// Requests above this are never pooled, whatever the setting says
+#define POOL_MAX_CLASS 2048
+
+// Size of the partition blocks the slabs are carved from
+#define POOL_SLAB_SIZE (64 * 1024)
+
+// Maximum number of slabs alive at once
+#define POOL_MAX_SLABS 16
+
+// Serves a small partition allocation from a slab. Returns a synthetic
+// UID, or a negative error if the request can't be pooled.
+SceUID pool_alloc(SceSize size);
+
+// Releases a synthetic UID. Returns SCE_KERNEL_ERROR_UNKNOWN_UID if it
+// does not belong to the pool.
+int pool_free(SceUID uid);
+
+// Returns the address behind a synthetic UID, or NULL if it does not
+// belong to the pool
+void *pool_addr(SceUID uid);
+
+// Forgets every slab. Their blocks are freed by the ledger.
+void pool_reset();
+
+#endif
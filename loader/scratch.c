@@ -0,0 +1,35 @@
+#include <common/scratch.h>
+#include <common/sdk.h>
+
+/*
+ * The loader has no arena and no ledger. Each buffer gets a partition
+ * block of its own, like before the arena existed, with the block UID
+ * stored in front of it. The loader pops its buffers in the reverse
+ * order of their allocation, so popping frees just the one given.
+ */
+#define SCRATCH_HEADER 16
+
+void *scratch_alloc(SceSize size)
+{
+	SceUID block;
+	char *p;
+
+	block = sceKernelAllocPartitionMemory(2, "HBL Scratch",
+		PSP_SMEM_Low, size + SCRATCH_HEADER, NULL);
+	if (block < 0)
+		return NULL;
+
+	p = sceKernelGetBlockHeadAddr(block);
+	if (p == NULL) {
+		sceKernelFreePartitionMemory(block);
+		return NULL;
+	}
+
+	*(SceUID *)p = block;
+	return p + SCRATCH_HEADER;
+}
+
+void scratch_pop(void *p)
+{
+	sceKernelFreePartitionMemory(*(SceUID *)((char *)p - SCRATCH_HEADER));
+}
@@ -0,0 +1,239 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <common/utils/scr.h>
+#include <common/globals.h>
+#include <common/memory.h>
+#include <common/sdk.h>
+#include "host.h"
+
+#define HOST_BLOCKS_MAX 1024
+#define HOST_MODULES_MAX 16
+
+/*
+ * isImported() reads the second word of an import stub, so the imports
+ * the sources test for start with a short jump over a nonzero word.
+ */
+#define HOST_IMPORT(name, impl) \
+	__asm__(".text\n\t.globl " #name "\n\t.p2align 3\n" #name ":\n" \
+		"\tjmp 1f\n\t.p2align 2\n\t.long 1\n1:\tjmp " #impl "\n")
+
+static int failures = 0;
+
+static struct {
+	void *p;
+	SceSize size;
+} blocks[HOST_BLOCKS_MAX];
+static int blocks_num = 0;
+static int allocs = 0;
+
+// Bytes of the partition, 0 for as much as the host has
+static SceSize partition_size = 0;
+
+static struct {
+	char *p;
+	SceSize size;
+	SceUID modid;
+} modules[HOST_MODULES_MAX];
+
+static int locked = 0;
+
+void host_check(int ok, const char *expr, const char *file, int line)
+{
+	if (ok)
+		return;
+
+	fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+	failures++;
+}
+
+static void map(unsigned long addr, size_t size)
+{
+	void *p;
+
+	p = mmap((void *)addr, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_NORESERVE,
+		-1, 0);
+	if (p != (void *)addr) {
+		fprintf(stderr, "can't map 0x%08lX\n", addr);
+		exit(2);
+	}
+}
+
+void host_init()
+{
+	// The sources cast addresses to int and expect them in user memory
+	map(GAME_MEMORY_START, 0x0A000000 - GAME_MEMORY_START);
+	map(0x10000, 0x4000);
+	map(0x04000000, 0x200000);
+}
+
+int host_done(const char *name)
+{
+	CHECK(locked == 0);
+
+	if (failures) {
+		printf("%s: %d checks failed\n", name, failures);
+		return 1;
+	}
+
+	printf("%s: ok\n", name);
+	return 0;
+}
+
+void host_partition(SceSize size)
+{
+	partition_size = size;
+}
+
+int host_allocs()
+{
+	return allocs;
+}
+
+int host_blocks()
+{
+	int i, n = 0;
+
+	for (i = 0; i < blocks_num; i++)
+		if (blocks[i].p != NULL)
+			n++;
+
+	return n;
+}
+
+void host_module_add(void *p, SceSize size, SceUID modid)
+{
+	int i;
+
+	for (i = 0; i < HOST_MODULES_MAX; i++)
+		if (modules[i].p == NULL) {
+			modules[i].p = p;
+			modules[i].size = size;
+			modules[i].modid = modid;
+			return;
+		}
+
+	fprintf(stderr, "too many modules\n");
+	exit(2);
+}
+
+void host_module_remove(SceUID modid)
+{
+	int i;
+
+	for (i = 0; i < HOST_MODULES_MAX; i++)
+		if (modules[i].p != NULL && modules[i].modid == modid)
+			modules[i].p = NULL;
+}
+
+static __attribute__((used)) SceUID get_module_id(u32 address)
+{
+	int i;
+
+	for (i = 0; i < HOST_MODULES_MAX; i++)
+		if (modules[i].p != NULL && address >= (u32)modules[i].p
+			&& address - (u32)modules[i].p < modules[i].size)
+		{
+			return modules[i].modid;
+		}
+
+	return SCE_KERNEL_ERROR_UNKNOWN_MODULE;
+}
+
+HOST_IMPORT(sceKernelGetModuleIdByAddress, get_module_id);
+
+// Block UIDs are the index in blocks + 1, like kernel UIDs they are > 0
+SceUID sceKernelAllocPartitionMemory(SceUID UNUSED(partitionid),
+	const char *UNUSED(name), int UNUSED(type), SceSize size,
+	void *UNUSED(addr))
+{
+	SceSize used = 0;
+	int i;
+
+	allocs++;
+
+	for (i = 0; i < blocks_num; i++)
+		if (blocks[i].p != NULL)
+			used += blocks[i].size;
+
+	if (partition_size && size > partition_size - used)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+
+	for (i = 0; i < blocks_num && blocks[i].p != NULL; i++);
+
+	if (i >= HOST_BLOCKS_MAX)
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+
+	if (posix_memalign(&blocks[i].p, 256, size ? size : 1)) {
+		blocks[i].p = NULL;
+		return SCE_KERNEL_ERROR_NO_MEMORY;
+	}
+
+	blocks[i].size = size;
+	if (i >= blocks_num)
+		blocks_num = i + 1;
+
+	return i + 1;
+}
+
+int sceKernelFreePartitionMemory(SceUID blockid)
+{
+	if (blockid <= 0 || blockid > blocks_num || blocks[blockid - 1].p == NULL)
+		return SCE_KERNEL_ERROR_UNKNOWN_UID;
+
+	free(blocks[blockid - 1].p);
+	blocks[blockid - 1].p = NULL;
+
+	return 0;
+}
+
+void *sceKernelGetBlockHeadAddr(SceUID blockid)
+{
+	if (blockid <= 0 || blockid > blocks_num)
+		return NULL;
+
+	return blocks[blockid - 1].p;
+}
+
+void sceKernelExitGame()
+{
+	exit(3);
+}
+
+int sceKernelExitGameWithStatus(int status)
+{
+	exit(status);
+}
+
+int sceDisplaySetFrameBuf(void *UNUSED(topaddr), int UNUSED(bufferwidth),
+	int UNUSED(pixelformat), int UNUSED(sync))
+{
+	return 0;
+}
+
+// The screen is stdout, unless the test links the real one
+__attribute__((weak)) void scr_printf(const char *fmt, ...)
+{
+	va_list va;
+
+	va_start(va, fmt);
+	vprintf(fmt, va);
+	va_end(va);
+}
+
+// Critical sections must not nest, since interrupts are masked only once
+int hblLock(SceUID UNUSED(semaid))
+{
+	CHECK(locked == 0);
+	locked++;
+
+	return 0;
+}
+
+void hblUnlock(SceUID UNUSED(semaid), int UNUSED(state))
+{
+	CHECK(locked == 1);
+	locked--;
+}
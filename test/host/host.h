@@ -0,0 +1,30 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include <common/sdk.h>
+
+// Counts a failure and reports where it happened, without stopping
+#define CHECK(e) host_check(!!(e), #e, __FILE__, __LINE__)
+
+void host_check(int ok, const char *expr, const char *file, int line);
+
+// Maps the fake user memory, the globals page and VRAM. Call it first.
+void host_init();
+
+// Prints the outcome and returns the exit status of the test
+int host_done(const char *name);
+
+// Makes [p, p + size) the memory of a loaded module, or forgets it
+void host_module_add(void *p, SceSize size, SceUID modid);
+void host_module_remove(SceUID modid);
+
+// Limits the partition to size bytes, 0 for no limit
+void host_partition(SceSize size);
+
+// Calls to sceKernelAllocPartitionMemory so far
+int host_allocs();
+
+// Partition blocks currently allocated through the fake kernel
+int host_blocks();
+
+#endif
@@ -0,0 +1 @@
+#include <psptypes.h>
@@ -0,0 +1,6 @@
+#include <psptypes.h>
+
+#define PSP_DISPLAY_PIXEL_FORMAT_8888 3
+#define PSP_DISPLAY_SETBUF_NEXTFRAME 1
+
+int sceDisplaySetFrameBuf(void *topaddr, int bufferwidth, int pixelformat, int sync);
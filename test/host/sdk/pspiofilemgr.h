@@ -0,0 +1,20 @@
+#include <psptypes.h>
+
+#define PSP_O_RDONLY 0x0001
+#define PSP_O_WRONLY 0x0002
+#define PSP_O_RDWR (PSP_O_RDONLY | PSP_O_WRONLY)
+#define PSP_O_CREAT 0x0200
+
+#define PSP_SEEK_SET 0
+#define PSP_SEEK_CUR 1
+#define PSP_SEEK_END 2
+
+int sceIoRead(SceUID fd, void *data, SceSize size);
+int sceIoWrite(SceUID fd, const void *data, SceSize size);
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence);
+int sceIoReadAsync(SceUID fd, void *data, SceSize size);
+int sceIoWriteAsync(SceUID fd, const void *data, SceSize size);
+int sceIoLseekAsync(SceUID fd, SceOff offset, int whence);
+int sceIoLseek32Async(SceUID fd, int offset, int whence);
+int sceIoIoctl(SceUID fd, unsigned int cmd, void *indata, int inlen, void *outdata, int outlen);
+int sceIoIoctlAsync(SceUID fd, unsigned int cmd, void *indata, int inlen, void *outdata, int outlen);
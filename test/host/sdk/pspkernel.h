@@ -0,0 +1,2 @@
+#include <psptypes.h>
+#include <pspiofilemgr.h>
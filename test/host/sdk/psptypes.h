@@ -0,0 +1,80 @@
+// Just enough of the PSPSDK to build the tested sources on a host
+#ifndef HOST_PSPTYPES_H
+#define HOST_PSPTYPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef int SceUID;
+typedef unsigned int SceSize;
+typedef int SceSSize;
+typedef unsigned int SceUInt;
+typedef int SceMode;
+typedef s64 SceOff;
+
+typedef struct {
+	unsigned int TimeStamp;
+	unsigned int Buttons;
+	unsigned char Lx;
+	unsigned char Ly;
+	unsigned char Rsrv[6];
+} SceCtrlData;
+
+typedef struct {
+	SceSize size;
+} SceKernelThreadOptParam;
+
+typedef struct {
+	SceSize size;
+} SceKernelSMOption;
+
+typedef struct {
+	u16 modattribute;
+	u8 modversion[2];
+	char modname[27];
+	char terminal;
+	void *gp_value;
+	void *ent_top;
+	void *ent_end;
+	void *stub_top;
+	void *stub_end;
+} SceModuleInfo;
+
+typedef struct {
+	const char *libname;
+	u8 version[2];
+	u16 attribute;
+	u8 len;
+	u8 vstubcount;
+	u16 stubcount;
+	void *entrytable;
+} SceLibraryEntryTable;
+
+#define PSP_SMEM_Low 0
+#define PSP_SMEM_High 1
+#define PSP_SMEM_Addr 2
+
+#define SCE_KERNEL_ERROR_ERROR 0x80020001
+#define SCE_KERNEL_ERROR_ILLEGAL_ARGUMENT 0x800200D2
+#define SCE_KERNEL_ERROR_ILLEGAL_ADDRESS 0x800200D3
+#define SCE_KERNEL_ERROR_UNKNOWN_UID 0x800200CB
+#define SCE_KERNEL_ERROR_UNKNOWN_MODULE 0x8002012E
+#define SCE_KERNEL_ERROR_NO_MEMORY 0x80020190
+#define SCE_KERNEL_ERROR_ERRNO_INVALID_ARGUMENT 0x80010016
+
+SceUID sceKernelAllocPartitionMemory(SceUID partitionid, const char *name, int type, SceSize size, void *addr);
+int sceKernelFreePartitionMemory(SceUID blockid);
+void *sceKernelGetBlockHeadAddr(SceUID blockid);
+void sceKernelExitGame();
+int sceKernelDelayThread(SceUInt delay);
+
+#endif
@@ -0,0 +1,53 @@
+#include <hbl/stubs/alloc.h>
+#include "host.h"
+
+// Requests size with min as the floor while free bytes are left
+static void check_fallback(SceSize free, SceSize size, SceSize min)
+{
+	SceSize got = size;
+	SceUID uid;
+	int calls, bound, n;
+
+	host_partition(free);
+	calls = host_allocs();
+
+	uid = alloc_fallback(2, "Test", PSP_SMEM_Low, &got, NULL, min);
+	calls = host_allocs() - calls;
+
+	if (free < min) {
+		CHECK(uid < 0 && got == size);
+		CHECK(host_blocks() == 0);
+		CHECK(calls == 1);
+		return;
+	}
+
+	// The largest size that fits, to within the granularity
+	CHECK(uid > 0 && host_blocks() == 1);
+	CHECK(got >= min && got <= free && free - got <= PARTITION_GRANULARITY);
+
+	// The floor, log2 of the range in probes, and maybe a last retry
+	for (n = size - min, bound = 2; n > PARTITION_GRANULARITY; n >>= 1)
+		bound++;
+	CHECK(calls <= bound);
+
+	sceKernelFreePartitionMemory(uid);
+}
+
+int main()
+{
+	SceSize free;
+
+	host_init();
+
+	check_fallback(0x100000, 0x140000, 0x100000);
+	check_fallback(0x0FFFFF, 0x140000, 0x100000);
+	check_fallback(0x13FF00, 0x140000, 0x100000);
+	check_fallback(0x100000, 20 * 1024 * 1024, 0x100000);
+
+	for (free = 0x100000; free < 0x140000; free += 0x1234)
+		check_fallback(free, 0x140000, 0x100000);
+
+	CHECK(host_blocks() == 0);
+
+	return host_done("alloc");
+}
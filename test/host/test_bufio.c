@@ -0,0 +1,266 @@
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <common/utils/string.h>
+#include <hbl/stubs/bufio.h>
+#include "host.h"
+
+#define FILES 4
+#define FILE_SIZE 4096
+
+int io_readahead;
+int io_writebehind;
+
+// Files behind descriptors 1 to FILES
+static struct {
+	char data[FILE_SIZE];
+	SceOff size;
+	SceOff pos;
+	int reads;
+	int writes;
+} files[FILES + 1];
+
+// Set to make the next sceIoWrite kill the calling thread
+static int kill_write = 0;
+static jmp_buf killed;
+
+static int delays = 0;
+
+int sceIoRead(SceUID fd, void *data, SceSize size)
+{
+	SceOff n = files[fd].size - files[fd].pos;
+
+	if (n > size)
+		n = size;
+	if (n < 0)
+		n = 0;
+
+	memcpy(data, files[fd].data + files[fd].pos, n);
+	files[fd].pos += n;
+	files[fd].reads++;
+
+	return n;
+}
+
+int sceIoWrite(SceUID fd, const void *data, SceSize size)
+{
+	if (kill_write) {
+		kill_write = 0;
+		longjmp(killed, 1);
+	}
+
+	memcpy(files[fd].data + files[fd].pos, data, size);
+	files[fd].pos += size;
+	if (files[fd].pos > files[fd].size)
+		files[fd].size = files[fd].pos;
+	files[fd].writes++;
+
+	return size;
+}
+
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence)
+{
+	if (whence == PSP_SEEK_CUR)
+		offset += files[fd].pos;
+	else if (whence == PSP_SEEK_END)
+		offset += files[fd].size;
+
+	files[fd].pos = offset;
+	return offset;
+}
+
+int sceIoReadAsync(SceUID UNUSED(fd), void *UNUSED(data), SceSize UNUSED(size))
+{
+	return 0;
+}
+
+int sceIoWriteAsync(SceUID UNUSED(fd), const void *UNUSED(data), SceSize UNUSED(size))
+{
+	return 0;
+}
+
+int sceIoLseekAsync(SceUID UNUSED(fd), SceOff UNUSED(offset), int UNUSED(whence))
+{
+	return 0;
+}
+
+int sceIoLseek32Async(SceUID UNUSED(fd), int UNUSED(offset), int UNUSED(whence))
+{
+	return 0;
+}
+
+int sceIoIoctl(SceUID UNUSED(fd), unsigned int UNUSED(cmd), void *UNUSED(indata),
+	int UNUSED(inlen), void *UNUSED(outdata), int UNUSED(outlen))
+{
+	return 0;
+}
+
+int sceIoIoctlAsync(SceUID UNUSED(fd), unsigned int UNUSED(cmd), void *UNUSED(indata),
+	int UNUSED(inlen), void *UNUSED(outdata), int UNUSED(outlen))
+{
+	return 0;
+}
+
+// Only ever called while waiting for another thread's claim, which can't
+// happen in a single thread
+int sceKernelDelayThread(SceUInt UNUSED(delay))
+{
+	if (++delays > 1000) {
+		fprintf(stderr, "waiting forever for a claim\n");
+		exit(1);
+	}
+
+	return 0;
+}
+
+static void put_file(SceUID fd, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		files[fd].data[i] = i * 13 + fd;
+	files[fd].size = size;
+	files[fd].pos = 0;
+	files[fd].reads = 0;
+	files[fd].writes = 0;
+}
+
+static void test_readahead()
+{
+	char buf[1024];
+	int i;
+
+	io_readahead = 256;
+	put_file(1, 1000);
+	bufio_open(1, "ms0:/PSP/GAME/data", PSP_O_RDONLY);
+
+	// Small reads come from the window
+	for (i = 0; i < 20; i++)
+		CHECK(_hook_sceIoRead(1, buf + i * 10, 10) == 10);
+	CHECK(!memcmp(buf, files[1].data, 200));
+	CHECK(files[1].reads == 1);
+
+	// Across the end of the window
+	CHECK(_hook_sceIoRead(1, buf, 100) == 100);
+	CHECK(!memcmp(buf, files[1].data + 200, 100));
+	CHECK(files[1].reads == 2);
+
+	// Back into the window without the kernel
+	CHECK(_hook_sceIoLseek(1, -20, PSP_SEEK_CUR) == 280);
+	CHECK(_hook_sceIoRead(1, buf, 20) == 20);
+	CHECK(!memcmp(buf, files[1].data + 280, 20));
+	CHECK(files[1].reads == 2);
+	CHECK(_hook_sceIoLseek(1, -1, PSP_SEEK_SET) == (SceOff)SCE_KERNEL_ERROR_ERRNO_INVALID_ARGUMENT);
+
+	// Big reads bypass it
+	CHECK(_hook_sceIoLseek32(1, 10, PSP_SEEK_SET) == 10);
+	CHECK(_hook_sceIoRead(1, buf, 600) == 600);
+	CHECK(!memcmp(buf, files[1].data + 10, 600));
+	CHECK(files[1].reads == 3);
+
+	// Up to the end of the file
+	CHECK(_hook_sceIoRead(1, buf, 500) == 390);
+	CHECK(!memcmp(buf, files[1].data + 610, 390));
+	CHECK(_hook_sceIoRead(1, buf, 10) == 0);
+
+	// Only the kernel knows where the end is
+	CHECK(_hook_sceIoLseek(1, -8, PSP_SEEK_END) == 992);
+	CHECK(_hook_sceIoRead(1, buf, 8) == 8);
+	CHECK(!memcmp(buf, files[1].data + 992, 8));
+
+	// The kernel is left where the homebrew is
+	CHECK(_hook_sceIoLseek(1, 30, PSP_SEEK_SET) == 30);
+	CHECK(bufio_detach(1) == 0);
+	CHECK(files[1].pos == 30);
+	CHECK(_hook_sceIoRead(1, buf, 4) == 4 && files[1].pos == 34);
+
+	// Other devices are not buffered
+	put_file(2, 100);
+	bufio_open(2, "umd0:/data", PSP_O_RDONLY);
+	CHECK(_hook_sceIoRead(2, buf, 10) == 10);
+	CHECK(_hook_sceIoRead(2, buf, 10) == 10);
+	CHECK(files[2].reads == 2);
+
+	CHECK(host_blocks() == 0);
+}
+
+static void test_writebehind()
+{
+	char buf[256], expect[512];
+	int i;
+
+	for (i = 0; i < (int)sizeof(expect); i++)
+		expect[i] = i * 7;
+
+	io_writebehind = 64;
+	put_file(4, 0);
+	bufio_open(4, "ef0:/save.bin", PSP_O_WRONLY | PSP_O_CREAT);
+
+	// Small writes are coalesced until the buffer is full
+	for (i = 0; i < 6; i++)
+		CHECK(_hook_sceIoWrite(4, expect + i * 10, 10) == 10);
+	CHECK(files[4].writes == 0);
+	CHECK(_hook_sceIoWrite(4, expect + 60, 10) == 10);
+	CHECK(files[4].writes == 1 && files[4].size == 60);
+
+	// Big writes go straight through, after what is pending
+	CHECK(_hook_sceIoWrite(4, expect + 70, 100) == 100);
+	CHECK(files[4].writes == 3 && files[4].size == 170);
+	CHECK(!memcmp(files[4].data, expect, 170));
+
+	// Anything else flushes first
+	CHECK(_hook_sceIoWrite(4, expect + 170, 30) == 30);
+	CHECK(_hook_sceIoLseek(4, 0, PSP_SEEK_CUR) == 200);
+	CHECK(files[4].size == 200 && !memcmp(files[4].data, expect, 200));
+
+	CHECK(_hook_sceIoWrite(4, expect + 200, 5) == 5);
+	CHECK(_hook_sceIoLseek(4, 0, PSP_SEEK_SET) == 0);
+	CHECK(_hook_sceIoRead(4, buf, 205) == 205);
+	CHECK(!memcmp(buf, expect, 205));
+
+	CHECK(_hook_sceIoWrite(4, expect + 205, 5) == 5);
+	CHECK(bufio_flush(4) == 0);
+	CHECK(files[4].size == 210 && !memcmp(files[4].data, expect, 210));
+
+	CHECK(_hook_sceIoWrite(4, expect + 210, 5) == 5);
+	CHECK(bufio_detach(4) == 0);
+	CHECK(files[4].size == 215 && !memcmp(files[4].data, expect, 215));
+
+	CHECK(host_blocks() == 0);
+}
+
+// A thread killed while it has a file claimed must not stall the flush
+// at exit, nor lose what it was writing
+static void test_killed()
+{
+	char buf[64];
+
+	io_writebehind = 64;
+	put_file(3, 0);
+	bufio_open(3, "ms0:/log.txt", PSP_O_WRONLY | PSP_O_CREAT);
+
+	memset(buf, 'a', sizeof(buf));
+	CHECK(_hook_sceIoWrite(3, buf, 10) == 10);
+
+	kill_write = 1;
+	if (!setjmp(killed))
+		_hook_sceIoWrite(3, buf, 60);
+	CHECK(!kill_write);
+
+	bufio_flush_all();
+	CHECK(delays == 0);
+	CHECK(files[3].size == 10 && !memcmp(files[3].data, buf, 10));
+
+	bufio_reset();
+}
+
+int main()
+{
+	host_init();
+
+	test_readahead();
+	test_writebehind();
+	test_killed();
+
+	return host_done("bufio");
+}
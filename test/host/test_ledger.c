@@ -0,0 +1,49 @@
+#include <common/utils/string.h>
+#include <common/ledger.h>
+#include "host.h"
+
+int main()
+{
+	LedgerEntry table[4];
+	SceUID hbl, loader, homebrew, other, untracked;
+
+	host_init();
+
+	// Without a table, blocks are only allocated and freed
+	other = ledger_alloc(LEDGER_LOADER, "Untracked", PSP_SMEM_Low, 64, NULL);
+	CHECK(other > 0 && host_blocks() == 1);
+	CHECK(ledger_cleanup() == 0 && host_blocks() == 1);
+	CHECK(ledger_free(other) == 0 && host_blocks() == 0);
+
+	ledger_init(table, 4);
+
+	hbl = ledger_alloc(LEDGER_HBL, "HBL Block", PSP_SMEM_Low, 64, NULL);
+	loader = ledger_alloc(LEDGER_LOADER, "A very long name", PSP_SMEM_Low, 100, NULL);
+	homebrew = ledger_alloc(LEDGER_HOMEBREW, NULL, PSP_SMEM_Low, 200, NULL);
+	other = ledger_alloc(LEDGER_HOMEBREW, "Other", PSP_SMEM_Low, 300, NULL);
+	CHECK(hbl > 0 && loader > 0 && homebrew > 0 && other > 0);
+
+	CHECK(!strcmp(table[1].name, "A very lon"));
+	CHECK(table[1].size == 100 && table[1].owner == LEDGER_LOADER);
+	CHECK(table[2].name[0] == '\0');
+
+	// A full ledger still hands out the block
+	untracked = ledger_alloc(LEDGER_LOADER, "Untracked", PSP_SMEM_Low, 64, NULL);
+	CHECK(untracked > 0 && host_blocks() == 5);
+	CHECK(ledger_add(0x1234, "Extra", 1, LEDGER_LOADER) == (int)SCE_KERNEL_ERROR_NO_MEMORY);
+
+	CHECK(ledger_free(other) == 0);
+	CHECK(ledger_remove(other) == (int)SCE_KERNEL_ERROR_ERROR);
+	CHECK(ledger_free(other) == (int)SCE_KERNEL_ERROR_UNKNOWN_UID);
+	CHECK(ledger_add(untracked, "Untracked", 64, LEDGER_HOMEBREW) == 0);
+
+	// Only the loader block is a leak, and HBL's own block stays
+	CHECK(ledger_cleanup() == 1);
+	CHECK(host_blocks() == 1);
+	CHECK(sceKernelGetBlockHeadAddr(hbl) != NULL);
+	CHECK(ledger_cleanup() == 0);
+
+	CHECK(ledger_free(hbl) == 0 && host_blocks() == 0);
+
+	return host_done("ledger");
+}
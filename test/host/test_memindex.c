@@ -0,0 +1,102 @@
+#include <common/utils/string.h>
+#include <hbl/modmgr/elf.h>
+#include <hbl/modmgr/memindex.h>
+#include "host.h"
+
+// Lays out a module at p with two exports, two stubs and its info
+static const SceModuleInfo *put_module(u32 p, const char *name, SceUID modid)
+{
+	SceModuleInfo *info = (void *)(p + 0x800);
+
+	memset((void *)p, 0, 0x1000);
+	strcpy(info->modname, name);
+	info->ent_top = (void *)(p + 0x100);
+	info->ent_end = (char *)info->ent_top + 2 * sizeof(SceLibraryEntryTable);
+	info->stub_top = (void *)(p + 0x200);
+	info->stub_end = (char *)info->stub_top + 2 * sizeof(tStubEntry);
+
+	host_module_add((void *)p, 0x1000, modid);
+
+	return info;
+}
+
+static void unload(u32 p, SceUID modid)
+{
+	host_module_remove(modid);
+	memset((void *)p, 0, 0x1000);
+}
+
+int main()
+{
+	MemIndexEntry table[2];
+	const SceModuleInfo *foo, *bar, *baz, *qux;
+	SceModuleInfo *bad;
+
+	host_init();
+
+	foo = put_module(0x08900000, "sceFoo", 0x100);
+
+	// Nothing is remembered before memindex_init
+	CHECK(memindex_add("sceFoo") == NULL);
+
+	memindex_init(table, 2);
+
+	// Names that are not in a module info are skipped, even in the module
+	strcpy((char *)0x08800001, "sceFoo");
+	memcpy((void *)0x08900401, foo, sizeof(*foo));
+	bad = (void *)0x08900500;
+	memcpy(bad, foo, sizeof(*bad));
+	bad->stub_end = (char *)bad->stub_end - 1;
+	bad = (void *)0x08900600;
+	memcpy(bad, foo, sizeof(*bad));
+	bad->ent_end = (char *)bad->ent_top + 4100;
+	bad = (void *)0x08900700;
+	memcpy(bad, foo, sizeof(*bad));
+	bad->stub_top = (void *)0x083FFFF0;
+	bad->stub_end = (char *)bad->stub_top + 2 * sizeof(tStubEntry);
+
+	CHECK(memindex_find("sceFoo") == NULL);
+	CHECK(memindex_add("sceFoo") == foo);
+	CHECK(memindex_find("sceFoo") == foo);
+	CHECK(memindex_add("sceFoo") == foo);
+
+	// The terminator is part of the name
+	bar = put_module(0x08A00000, "sceFooBar", 0x101);
+	CHECK(memindex_add("sceFooBar") == bar);
+	CHECK(memindex_add("sceFoo") == foo);
+	CHECK(memindex_add("sceFo") == NULL);
+
+	// A module that went away is forgotten, even if its info is still
+	// in memory
+	host_module_remove(0x100);
+	CHECK(memindex_find("sceFoo") == NULL);
+	CHECK(memindex_add("sceFoo") == NULL);
+	memset((void *)0x08900000, 0, 0x1000);
+
+	// And found again where it is loaded next
+	foo = put_module(0x08980000, "sceFoo", 0x102);
+	CHECK(memindex_add("sceFoo") == foo);
+	CHECK(memindex_find("sceFooBar") == bar);
+
+	// The index is full, the module is found but not remembered
+	baz = put_module(0x08B00000, "sceBaz", 0x103);
+	CHECK(memindex_add("sceBaz") == NULL);
+	CHECK(memindex_find("sceBaz") == NULL);
+
+	// Pruning makes room
+	unload(0x08A00000, 0x101);
+	memindex_prune();
+	CHECK(memindex_find("sceFooBar") == NULL);
+	CHECK(memindex_add("sceBaz") == baz);
+	CHECK(memindex_find("sceFoo") == foo);
+
+	qux = put_module(0x09FFF000, "sceQux", 0x104);
+	unload(0x08B00000, 0x103);
+	unload(0x08980000, 0x102);
+	memindex_prune();
+	CHECK(memindex_find("sceFoo") == NULL);
+	CHECK(memindex_find("sceBaz") == NULL);
+	CHECK(memindex_add("sceQux") == qux);
+
+	return host_done("memindex");
+}
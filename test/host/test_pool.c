@@ -0,0 +1,111 @@
+#include <common/utils/string.h>
+#include <hbl/stubs/pool.h>
+#include "host.h"
+
+#define CLASSES 8
+
+static void test_classes()
+{
+	static const SceSize sizes[] = { 1, 16, 17, 32, 100, 1024, 2000, 2048 };
+	static const SceSize classes[] = { 16, 16, 32, 32, 128, 1024, 2048, 2048 };
+	SceUID uids[CLASSES];
+	char *p, *q;
+	int i;
+
+	CHECK(pool_alloc(0) == (SceUID)SCE_KERNEL_ERROR_ILLEGAL_ARGUMENT);
+	CHECK(pool_alloc(POOL_MAX_CLASS + 1) == (SceUID)SCE_KERNEL_ERROR_ILLEGAL_ARGUMENT);
+
+	for (i = 0; i < CLASSES; i++) {
+		uids[i] = pool_alloc(sizes[i]);
+		CHECK(uids[i] >= 0 && pool_addr(uids[i]) != NULL);
+	}
+
+	// Objects of one class are packed one after the other
+	for (i = 0; i < CLASSES; i += 2) {
+		p = pool_addr(uids[i]);
+		q = pool_addr(uids[i + 1]);
+		if (classes[i] == classes[i + 1])
+			CHECK(q - p == (int)classes[i]);
+	}
+
+	CHECK(host_blocks() == 5);
+
+	for (i = 0; i < CLASSES; i++)
+		CHECK(pool_free(uids[i]) == 0);
+
+	// Empty slabs are given back
+	CHECK(host_blocks() == 0);
+}
+
+static void test_uids()
+{
+	SceUID a, b;
+
+	CHECK(pool_free(0x1234) == (int)SCE_KERNEL_ERROR_UNKNOWN_UID);
+	CHECK(pool_addr(0x1234) == NULL);
+
+	a = pool_alloc(64);
+	b = pool_alloc(64);
+	CHECK(pool_free(a) == 0);
+	CHECK(pool_free(a) == (int)SCE_KERNEL_ERROR_UNKNOWN_UID);
+	CHECK(pool_addr(a) == NULL);
+	CHECK(pool_addr(b) != NULL);
+
+	// A tagged UID out of the slab range is refused
+	CHECK(pool_free((b & 0xFF000FFF) | 0xFFF000) == (int)SCE_KERNEL_ERROR_UNKNOWN_UID);
+
+	// The freed slot is handed out again
+	CHECK(pool_alloc(50) == a);
+
+	pool_free(a);
+	pool_free(b);
+	CHECK(host_blocks() == 0);
+}
+
+// Fills every slab of the largest class, then frees in a scattered order
+static void test_full()
+{
+	static SceUID uids[POOL_MAX_SLABS * (POOL_SLAB_SIZE / POOL_MAX_CLASS)];
+	const int n = sizeof(uids) / sizeof(uids[0]);
+	char *p;
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+		uids[i] = pool_alloc(POOL_MAX_CLASS);
+		CHECK(uids[i] >= 0);
+		p = pool_addr(uids[i]);
+		if (p != NULL)
+			memset(p, i, POOL_MAX_CLASS);
+	}
+
+	CHECK(host_blocks() == POOL_MAX_SLABS);
+	CHECK(pool_alloc(POOL_MAX_CLASS) == (SceUID)SCE_KERNEL_ERROR_NO_MEMORY);
+	CHECK(pool_alloc(16) == (SceUID)SCE_KERNEL_ERROR_NO_MEMORY);
+	CHECK(host_blocks() == POOL_MAX_SLABS);
+
+	// No object was written over by another
+	for (i = 0; i < n; i++) {
+		p = pool_addr(uids[i]);
+		for (j = 0; p != NULL && j < POOL_MAX_CLASS; j++)
+			if (p[j] != (char)i) {
+				CHECK(p[j] == (char)i);
+				break;
+			}
+	}
+
+	for (i = 0; i < n; i++)
+		CHECK(pool_free(uids[i * 37 % n]) == 0);
+
+	CHECK(host_blocks() == 0);
+}
+
+int main()
+{
+	host_init();
+
+	test_classes();
+	test_uids();
+	test_full();
+
+	return host_done("pool");
+}
@@ -0,0 +1,61 @@
+#include <common/utils/fnt.h>
+#include <common/utils/scr.h>
+#include <common/utils/string.h>
+#include "host.h"
+
+#define LINE_SIZE 512
+#define SCR_WIDTH 480
+
+static int (* const vram)[LINE_SIZE] = (void *)0x04000000;
+
+// Returns !=0 if the cell at x, y shows c in col
+static int check_cell(int x, int y, int c, int col)
+{
+	int fnt_x, fnt_y, pixel;
+
+	for (fnt_y = 0; fnt_y < FNT_HEIGHT; fnt_y++)
+		for (fnt_x = 0; fnt_x < FNT_WIDTH; fnt_x++) {
+			pixel = fnt[c][fnt_y] & (0x80 >> fnt_x) ? col : 0;
+			if (vram[y + fnt_y][x + fnt_x] != pixel)
+				return 0;
+		}
+
+	return 1;
+}
+
+int main()
+{
+	char s[0x7F - ' ' + 1];
+	int c, i, x, y;
+
+	host_init();
+
+	// Every row starts dirty, so all of them are cleared
+	memset(vram, 0x55, sizeof(vram[0]) * 272);
+	scr_init();
+	for (y = 0; y < 272; y++)
+		for (x = 0; x < SCR_WIDTH; x++)
+			if (vram[y][x]) {
+				CHECK(vram[y][x] == 0);
+				y = 272;
+				break;
+			}
+
+	for (c = ' '; c < 0x7F; c++)
+		s[c - ' '] = c;
+	s[c - ' '] = '\0';
+
+	// Lines wrap at the right edge
+	scr_puts_col(s, 0x00C0FFEE);
+	for (i = 0; s[i]; i++) {
+		x = i % (SCR_WIDTH / FNT_WIDTH) * FNT_WIDTH;
+		y = i / (SCR_WIDTH / FNT_WIDTH) * FNT_HEIGHT;
+		CHECK(check_cell(x, y, s[i], 0x00C0FFEE));
+	}
+
+	// Blank pixels of a glyph clear whatever was under them
+	scr_puts_col("#\b ", 0x00FFFFFF);
+	CHECK(check_cell(0, 2 * FNT_HEIGHT, ' ', 0));
+
+	return host_done("scr");
+}
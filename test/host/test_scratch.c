@@ -0,0 +1,69 @@
+#include <common/scratch.h>
+#include "host.h"
+
+int main()
+{
+	char *a, *b, *c, *d, *o[SCRATCH_OVERFLOW_MAX];
+	int i;
+
+	host_init();
+
+	// Without an arena, requests get blocks of their own
+	a = scratch_alloc(100);
+	CHECK(a != NULL && host_blocks() == 1);
+	scratch_pop(a);
+	CHECK(host_blocks() == 0);
+
+	CHECK(scratch_init(256) == 0 && host_blocks() == 1);
+
+	// Buffers are aligned and packed
+	a = scratch_alloc(1);
+	b = scratch_alloc(17);
+	c = scratch_alloc(16);
+	CHECK(((u32)a & 15) == 0);
+	CHECK(b == a + 16 && c == b + 32);
+
+	// Popping releases the buffer and those after it
+	scratch_pop(b);
+	CHECK(scratch_alloc(8) == b);
+
+	// What doesn't fit overflows, and nothing is bump-allocated over it
+	d = scratch_alloc(256);
+	CHECK(d != NULL && host_blocks() == 2);
+	c = scratch_alloc(16);
+	CHECK(c != NULL && host_blocks() == 3);
+	scratch_pop(d);
+	CHECK(host_blocks() == 1);
+	CHECK(scratch_alloc(16) == b + 16);
+
+	scratch_pop(a);
+	for (i = 0; i < SCRATCH_OVERFLOW_MAX; i++) {
+		o[i] = scratch_alloc(4000);
+		CHECK(o[i] != NULL);
+	}
+	CHECK(scratch_alloc(4000) == NULL);
+	CHECK(host_blocks() == 1 + SCRATCH_OVERFLOW_MAX);
+
+	// The arena grows to what the last load needed
+	scratch_reset();
+	CHECK(host_blocks() == 1);
+	a = scratch_alloc(4000 * SCRATCH_OVERFLOW_MAX);
+	CHECK(a != NULL && host_blocks() == 1);
+	CHECK(scratch_alloc(4096 * SCRATCH_OVERFLOW_MAX - 4000 * SCRATCH_OVERFLOW_MAX) != NULL);
+	CHECK(host_blocks() == 1);
+
+	// But never past SCRATCH_MAX_SIZE
+	scratch_reset();
+	a = scratch_alloc(SCRATCH_MAX_SIZE * 2);
+	CHECK(a != NULL && host_blocks() == 2);
+	scratch_reset();
+	CHECK(host_blocks() == 1);
+	a = scratch_alloc(SCRATCH_MAX_SIZE);
+	CHECK(a != NULL && host_blocks() == 1);
+	CHECK(scratch_alloc(16) != NULL && host_blocks() == 2);
+
+	scratch_reset();
+	CHECK(host_blocks() == 1);
+
+	return host_done("scratch");
+}
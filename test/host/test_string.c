@@ -0,0 +1,82 @@
+#include <common/utils/string.h>
+#include "host.h"
+
+#define MAX_LEN 80
+#define GUARD 16
+
+static unsigned char src[MAX_LEN + 2 * GUARD] __attribute__((aligned(16)));
+static unsigned char dst[MAX_LEN + 2 * GUARD] __attribute__((aligned(16)));
+
+// Returns !=0 if only dst[off..off+n) differs from what fill() left
+static int check_guards(int off, int n)
+{
+	int i;
+
+	for (i = 0; i < (int)sizeof(dst); i++)
+		if ((i < GUARD + off || i >= GUARD + off + n) && dst[i] != 0xA5)
+			return 0;
+
+	return 1;
+}
+
+static void fill()
+{
+	int i;
+
+	for (i = 0; i < (int)sizeof(src); i++) {
+		src[i] = i * 7 + 1;
+		dst[i] = 0xA5;
+	}
+}
+
+// Every source and destination alignment, across the tails of both loops
+static void test_memcpy()
+{
+	int s, d, n, i, ok;
+
+	for (s = 0; s < 8; s++)
+		for (d = 0; d < 8; d++)
+			for (n = 0; n <= MAX_LEN - 8; n++) {
+				fill();
+				CHECK(memcpy(dst + GUARD + d, src + GUARD + s, n)
+					== dst + GUARD + d);
+
+				ok = 1;
+				for (i = 0; i < n; i++)
+					if (dst[GUARD + d + i] != src[GUARD + s + i])
+						ok = 0;
+				CHECK(ok);
+				CHECK(check_guards(d, n));
+			}
+}
+
+static void test_memset()
+{
+	static const int vals[] = { 0, 0x5A, 0x80, 0xFF, 0x1234 };
+	int v, d, n, i, ok;
+
+	for (v = 0; v < (int)(sizeof(vals) / sizeof(vals[0])); v++)
+		for (d = 0; d < 8; d++)
+			for (n = 0; n <= MAX_LEN - 8; n++) {
+				fill();
+				CHECK(memset(dst + GUARD + d, vals[v], n)
+					== dst + GUARD + d);
+
+				ok = 1;
+				for (i = 0; i < n; i++)
+					if (dst[GUARD + d + i] != (unsigned char)vals[v])
+						ok = 0;
+				CHECK(ok);
+				CHECK(check_guards(d, n));
+			}
+}
+
+int main()
+{
+	host_init();
+
+	test_memcpy();
+	test_memset();
+
+	return host_done("string");
+}
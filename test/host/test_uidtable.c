@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <common/uidtable.h>
+#include "host.h"
+
+typedef struct {
+	SceUID uid;
+	int val;
+} Entry;
+
+// Returns the number of slots holding uid, checking the payload
+static int count(const UidTable *t, SceUID uid)
+{
+	const Entry *e = t->entries;
+	unsigned i;
+	int n = 0;
+
+	for (i = 0; i < UIDTABLE_SLOTS(t); i++)
+		if (e[i].uid == uid) {
+			CHECK(e[i].val == ~uid);
+			n++;
+		}
+
+	return n;
+}
+
+static void test_basic()
+{
+	Entry storage[16];
+	UidTable t = { storage, sizeof(Entry), 4, 0 };
+	Entry *e;
+	int i;
+
+	uidtable_clear(&t);
+
+	CHECK(uidtable_find(&t, 0x1234) == NULL);
+	CHECK(uidtable_add(&t, 0) == NULL);
+
+	e = uidtable_add(&t, 0x1234);
+	CHECK(e != NULL && e->uid == 0x1234 && e->val == 0);
+	e->val = 5;
+	CHECK(uidtable_add(&t, 0x1234) == e && e->val == 5);
+	CHECK(uidtable_find(&t, 0x1234) == e);
+	CHECK(t.num == 1);
+
+	uidtable_remove(&t, 0x4321);
+	CHECK(t.num == 1);
+	uidtable_remove(&t, 0x1234);
+	CHECK(t.num == 0 && uidtable_find(&t, 0x1234) == NULL);
+
+	// Full at 3/4 of the slots
+	for (i = 1; i <= 12; i++)
+		CHECK(uidtable_add(&t, i * 0x10001) != NULL);
+	CHECK(uidtable_add(&t, 13 * 0x10001) == NULL);
+	CHECK(uidtable_add(&t, 5 * 0x10001) != NULL);
+
+	uidtable_clear(&t);
+	CHECK(t.num == 0);
+	for (i = 1; i <= 12; i++)
+		CHECK(uidtable_find(&t, i * 0x10001) == NULL);
+}
+
+/*
+ * Random adds and removes on small, crowded tables against a plain array,
+ * so that clusters wrap around the end and removals have to pull entries
+ * back across the wrap.
+ */
+static void test_random(unsigned bits, unsigned seed)
+{
+	Entry storage[1 << 6];
+	UidTable t = { storage, sizeof(Entry), bits, 0 };
+	SceUID uids[48];
+	char in[48];
+	unsigned i, j, num = 0;
+	Entry *e;
+
+	srand(seed);
+	uidtable_clear(&t);
+
+	for (i = 0; i < 48; i++) {
+		uids[i] = 0x04000000 | (rand() & 0xFFFF) << 8 | (i + 1);
+		in[i] = 0;
+	}
+
+	for (j = 0; j < 4000; j++) {
+		i = rand() % 48;
+
+		if (in[i]) {
+			uidtable_remove(&t, uids[i]);
+			in[i] = 0;
+			num--;
+		} else {
+			e = uidtable_add(&t, uids[i]);
+			if (num >= UIDTABLE_SLOTS(&t) / 4 * 3) {
+				CHECK(e == NULL);
+				continue;
+			}
+
+			CHECK(e != NULL);
+			if (e == NULL)
+				continue;
+
+			e->val = ~uids[i];
+			in[i] = 1;
+			num++;
+		}
+
+		CHECK(t.num == num);
+		for (i = 0; i < 48; i++) {
+			CHECK(count(&t, uids[i]) == in[i]);
+			e = uidtable_find(&t, uids[i]);
+			CHECK(in[i] ? e != NULL && e->uid == uids[i] : e == NULL);
+		}
+	}
+}
+
+int main()
+{
+	unsigned seed;
+
+	host_init();
+
+	test_basic();
+	for (seed = 1; seed <= 8; seed++) {
+		test_random(3, seed);
+		test_random(4, seed);
+		test_random(6, seed);
+	}
+
+	return host_done("uidtable");
+}
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <common/utils/string.h>
+#include <common/utils.h>
+#include "host.h"
+
+#define AREA 512
+
+// Bytes past the area, so that matches may run over its end
+static char buf[AREA + 64];
+
+// The first position before size where s is found with its terminator
+static void *naive_findstr(const char *s, const char *p, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		if (!strcmp(p + i, s))
+			return (void *)(p + i);
+
+	return NULL;
+}
+
+static void test_findstr_fixed()
+{
+	static char big[600];
+	char *at;
+
+	memset(buf, 'x', sizeof(buf));
+	buf[sizeof(buf) - 1] = '\0';
+
+	strcpy(buf + 100, "sceNet_Library");
+	CHECK(findstr("sceNet_Library", buf, AREA) == buf + 100);
+	CHECK(findstr("sceNet", buf, AREA) == NULL);
+	CHECK(findstr("Library", buf, AREA) == buf + 107);
+	CHECK(findstr("sceNet_Library", buf, 100) == NULL);
+
+	// Right at the start and with the terminator as the last byte
+	strcpy(buf, "abc");
+	CHECK(findstr("abc", buf, 4) == buf);
+	CHECK(findstr("abc", buf, 1) == buf);
+	CHECK(findstr("", buf, AREA) == buf + 3);
+
+	// Starting in the area but ending past it
+	strcpy(buf + AREA - 2, "tail");
+	CHECK(findstr("tail", buf + 200, AREA - 200) == buf + AREA - 2);
+
+	// Too long for the skip table
+	memset(big, 'y', sizeof(big) - 1);
+	big[0] = 'z';
+	at = big + 300;
+	at[-1] = '\0';
+	CHECK(findstr(at, big, sizeof(big)) == at);
+}
+
+// Random areas over a small alphabet, so that partial matches abound
+static void test_findstr_random()
+{
+	static const char alphabet[] = "aab\0";
+	char s[8];
+	int i, j, m, size;
+
+	srand(1);
+	for (i = 0; i < 20000; i++) {
+		for (j = 0; j < (int)sizeof(buf) - 1; j++)
+			buf[j] = alphabet[rand() % 4];
+		buf[sizeof(buf) - 1] = '\0';
+
+		m = 1 + rand() % 6;
+		for (j = 0; j < m; j++)
+			s[j] = alphabet[rand() % 3];
+		s[m] = '\0';
+
+		size = rand() % (AREA + 1);
+		CHECK(findstr(s, buf, size) == naive_findstr(s, buf, size));
+	}
+}
+
+static void test_findw()
+{
+	int w[40];
+	int i, n;
+
+	for (i = 0; i < 40; i++)
+		w[i] = i + 1;
+
+	for (n = 0; n <= 40; n++)
+		for (i = 0; i < 40; i++)
+			CHECK(findw(i + 1, w, n * sizeof(int)) == (i < n ? w + i : NULL));
+
+	CHECK(findw(0, w, sizeof(w)) == NULL);
+
+	// The first occurrence wins
+	w[9] = 3;
+	CHECK(findw(3, w, sizeof(w)) == w + 2);
+
+	// A partial word at the end is not looked at
+	CHECK(findw(1, w, 7) == w);
+	CHECK(findw(2, w, 7) == NULL);
+	CHECK(findw(3, w, 11) == NULL);
+}
+
+int main()
+{
+	host_init();
+
+	test_findstr_fixed();
+	test_findstr_random();
+	test_findw();
+
+	return host_done("utils");
+}
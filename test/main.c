@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <string.h>
 #include <pspsdk.h>
 #include <pspkernel.h>
@@ -115,6 +116,114 @@ static int testMd5()
 	return 0;
 }
 
+static int checkDigest(const u8 *digest, const char *correct)
+{
+	char hex[33];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		sprintf(hex + i * 2, "%02x", digest[i]);
+
+	if (strcmp(hex, correct)) {
+		printf("NG\n  got %s\n  expected %s\n", hex, correct);
+		return -1;
+	}
+
+	printf("OK\n");
+	return 0;
+}
+
+// RFC 1321 test suite, then a million "a" fed in unaligned pieces, which
+// goes past the 64 KiB the context's usComputed can count
+static int testMd5Vectors()
+{
+	static const char * const vectors[][2] = {
+		{ "", "d41d8cd98f00b204e9800998ecf8427e" },
+		{ "a", "0cc175b9c0f1b6a831c399e269772661" },
+		{ "abc", "900150983cd24fb0d6963f7d28e17f72" },
+		{ "message digest", "f96b697d7cb7938d525a2f31aaf161d0" },
+		{ "abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b" },
+		{ "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+			"d174ab98d277d9f5a5611c2c9f419d9f" },
+		{ "12345678901234567890123456789012345678901234567890123456789012345678901234567890",
+			"57edf4a22be3c955ac49da2e2107b67a" }
+	};
+	static u8 data[1001] __attribute__((aligned(4)));
+	SceKernelUtilsMd5Context ctx;
+	u8 digest[16], aligned[16];
+	u32 start, time;
+	int i, off, ret = 0;
+
+	for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		printf("MD5 (\"%.16s\")...", vectors[i][0]);
+		sceKernelUtilsMd5Digest((u8 *)vectors[i][0],
+			strlen(vectors[i][0]), digest);
+		if (checkDigest(digest, vectors[i][1]))
+			ret = -1;
+	}
+
+	// Streamed from an aligned buffer, which is hashed in place, then
+	// from an unaligned one, which is copied
+	memset(data, 'a', sizeof(data));
+	for (off = 0; off < 2; off++) {
+		printf("MD5 (a million \"a\", %s)...", off ? "unaligned" : "aligned");
+		start = sceKernelGetSystemTimeLow();
+		sceKernelUtilsMd5BlockInit(&ctx);
+		for (i = 0; i < 1000; i++)
+			sceKernelUtilsMd5BlockUpdate(&ctx, data + off, 1000);
+		sceKernelUtilsMd5BlockResult(&ctx, off ? digest : aligned);
+		time = sceKernelGetSystemTimeLow() - start;
+		if (checkDigest(off ? digest : aligned,
+			"7707d6ae4e027c70eea2a935c2296f21"))
+		{
+			ret = -1;
+		}
+		printf("  %d us\n", time);
+	}
+
+	if (memcmp(digest, aligned, sizeof(digest))) {
+		puts("MD5: aligned and unaligned digests differ");
+		ret = -1;
+	}
+
+	if (ret)
+		nbErrors++;
+
+	return ret;
+}
+
+// Reference MT19937 output for the default seed, and its 10000th draw
+static int testMt19937()
+{
+	static const u32 first[] = {
+		3499211612u, 581869302u, 3890346734u, 3586334585u, 545404204u
+	};
+	SceKernelUtilsMt19937Context ctx;
+	u32 start, time, val = 0;
+	int i;
+
+	printf("sceKernelUtilsMt19937UInt...");
+	sceKernelUtilsMt19937Init(&ctx, 5489);
+	start = sceKernelGetSystemTimeLow();
+	for (i = 0; i < 10000; i++) {
+		val = sceKernelUtilsMt19937UInt(&ctx);
+		if (i < sizeof(first) / sizeof(first[0]) && val != first[i]) {
+			printf("NG\n  draw %d: got %u, expected %u\n",
+				i, val, first[i]);
+			return error();
+		}
+	}
+	time = sceKernelGetSystemTimeLow() - start;
+
+	if (val != 4123659995u) {
+		printf("NG\n  draw 9999: got %u, expected 4123659995\n", val);
+		return error();
+	}
+
+	printf("OK\n  10000 draws in %d us\n", time);
+	return 1;
+}
+
 static int testIoDread(const char *path)
 {
 	SceIoDirent ent;
@@ -163,6 +272,8 @@ int main(int argc, char *argv[])
     testFreeRam();
     testFrequencies();
     testMd5();
+    testMd5Vectors();
+    testMt19937();
 
 	dir = argv[0];
 	if (dir == NULL) {
@@ -0,0 +1,95 @@
+#!/usr/bin/ruby
+# Decodes the binary event log HBL writes to TRACE.BIN when built with
+# "make TRACE=1", either into text or into a JSON timeline that
+# chrome://tracing and Perfetto can open.
+#
+# The record layout and the event IDs must match include/common/trace.h
+
+def help
+	puts 'Usage: ' + $0 + %Q[ [--json] <TRACE.BIN>
+
+  --json  print a Chrome trace viewer timeline instead of text
+]
+end
+
+MAGIC = 0x544C4248
+
+# ID => [name, format of the arguments]
+EVENTS = {
+	0 => ['lost', '%<a>d records dropped'],
+	1 => ['module_load', 'module %<a>d at 0x%<b>08X, %<c>d bytes'],
+	2 => ['module_start', 'module %<a>d entry 0x%<b>08X, thread 0x%<c>08X'],
+	3 => ['nid', 'NID 0x%<a>08X at 0x%<b>08X -> 0x%<c>08X'],
+	4 => ['hook', 'NID 0x%<a>08X at 0x%<b>08X hooked with 0x%<c>08X'],
+	5 => ['alloc', 'block 0x%<a>08X, %<b>d bytes, owner %<c>d'],
+	6 => ['free', 'block 0x%<a>08X'],
+	7 => ['thread_create', 'thread 0x%<a>08X entry 0x%<b>08X, priority 0x%<c>X'],
+	8 => ['thread_start', 'thread 0x%<a>08X'],
+	9 => ['thread_exit', 'thread 0x%<a>08X, status 0x%<b>08X']
+}
+
+json = ARGV.delete('--json')
+if (!ARGV[0])
+	help()
+	abort()
+end
+
+data = File.binread(ARGV[0])
+magic, version, record_size, tick_rate = data.unpack('VvvV')
+if (magic != MAGIC)
+	abort(ARGV[0] + ' is not an HBL trace')
+end
+if (version != 1)
+	abort('Unsupported trace version ' + version.to_s)
+end
+
+# The tick is the low word of the system time, so undo its wrap around
+records = []
+last = nil
+high = 0
+off = 12
+while (off + record_size <= data.bytesize)
+	event, _, tick, a, b, c = data[off, record_size].unpack('vvVVVV')
+	off += record_size
+
+	high += 1 << 32 if (last && tick < last)
+	last = tick
+
+	records << { :event => event, :tick => high + tick, :a => a, :b => b, :c => c }
+end
+
+start = records.empty? ? 0 : records[0][:tick]
+
+def describe(r)
+	name, format = EVENTS[r[:event]] || ['event_' + r[:event].to_s, '0x%<a>08X 0x%<b>08X 0x%<c>08X']
+	[name, format % r]
+end
+
+if (!json)
+	records.each { |r|
+		name, text = describe(r)
+		printf("%12.6f %-14s %s\n", (r[:tick] - start).to_f / tick_rate, name, text)
+	}
+	exit
+end
+
+# Threads get a track each, running from their start to their exit;
+# everything else is an instant event on HBL's track
+events = []
+records.each { |r|
+	name, text = describe(r)
+	ts = (r[:tick] - start) * 1000000.0 / tick_rate
+
+	case r[:event]
+	when 8
+		events << %Q[{"name":"thread 0x%08X","ph":"B","ts":%.3f,"pid":1,"tid":%d}] % [r[:a], ts, r[:a]]
+	when 9
+		events << %Q[{"ph":"E","ts":%.3f,"pid":1,"tid":%d,"args":{"status":"0x%08X"}}] % [ts, r[:a], r[:b]]
+	else
+		events << %Q[{"name":"%s","ph":"i","s":"t","ts":%.3f,"pid":1,"tid":0,"args":{"detail":"%s"}}] % [name, ts, text]
+	end
+}
+
+puts '{"traceEvents":['
+puts events.join(",\n")
+puts ']}'